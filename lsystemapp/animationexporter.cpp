@@ -0,0 +1,140 @@
+#include "animationexporter.h"
+
+#include <util/apngwriter.h>
+
+#include <QBuffer>
+#include <QFileInfo>
+#include <QQueue>
+#include <QtConcurrent>
+
+namespace {
+
+struct EncodedFrame
+{
+	QByteArray png; // only for APNG, frames of a sequence are written directly
+	QString error;
+};
+
+EncodedFrame encodeFrame(const QImage & image, const QString & sequenceFileName)
+{
+	EncodedFrame rv;
+	if (!sequenceFileName.isEmpty()) {
+		if (!image.save(sequenceFileName, "PNG")) rv.error = QString("could not write %1").arg(sequenceFileName);
+		return rv;
+	}
+	QBuffer buffer(&rv.png);
+	buffer.open(QIODevice::WriteOnly);
+	if (!image.save(&buffer, "PNG")) rv.error = "could not encode frame";
+	return rv;
+}
+
+QString sequenceFileName(const QString & fileName, int frame)
+{
+	const QFileInfo info(fileName);
+	return info.path() + "/" + info.completeBaseName() + QString("_%1.png").arg(frame + 1, 5, 10, QChar('0'));
+}
+
+} // namespace
+
+namespace lsystem {
+
+AnimationExporter::AnimationExporter()
+{
+	connect(&watcher, &QFutureWatcher<QString>::finished, this, [this]() { emit finished(watcher.result()); });
+}
+
+AnimationExporter::~AnimationExporter()
+{
+	cancel();
+	watcher.waitForFinished();
+}
+
+void AnimationExporter::start(const QSharedPointer<ui::Drawing> & drawing, const AnimationExportSettings & settings)
+{
+	if (isActive()) {
+		emit finished("an export is already running");
+		return;
+	}
+	cancelRequested = false;
+	watcher.setFuture(QtConcurrent::run([this, drawing, settings]() { return run(drawing, settings); }));
+}
+
+void AnimationExporter::cancel() { cancelRequested = true; }
+
+QString AnimationExporter::run(const QSharedPointer<ui::Drawing> & drawing, const AnimationExportSettings & settings)
+{
+	if (drawing->mainMeta.densityMode) return "density drawings cannot be exported as animation";
+	if (drawing->spilledSegments) return "out-of-core drawings cannot be exported as animation";
+	const int numSegs = static_cast<int>(drawing->segments.size());
+	if (numSegs == 0) return "the drawing has no segments";
+	if (settings.resolution.isEmpty()) return "invalid resolution";
+
+	const int segmentsPerFrame = qMax(settings.segmentsPerFrame, 1);
+	const int requestedFrames = settings.frameCount > 0 ? settings.frameCount : (numSegs + segmentsPerFrame - 1) / segmentsPerFrame;
+	const int frameCount = qMin(numSegs, requestedFrames);
+	const auto segmentsUntilFrame = [&](int frame) {
+		if (settings.frameCount <= 0 && settings.segmentsPerFrame > 0) return qMin(numSegs, (frame + 1) * settings.segmentsPerFrame);
+		return static_cast<int>(static_cast<qint64>(numSegs) * (frame + 1) / frameCount);
+	};
+
+	// fit the drawing into the resolution
+	const QPoint drawingSize = drawing->size() + QPoint(1, 1);
+	const double scale = qMin(static_cast<double>(settings.resolution.width()) / drawingSize.x(),
+							  static_cast<double>(settings.resolution.height()) / drawingSize.y());
+	// The segments accumulate on a transparent image, every frame composes it onto the background.
+	QImage accumulated(settings.resolution, QImage::Format_ARGB32_Premultiplied);
+	accumulated.fill(Qt::transparent);
+	QPainter painter(&accumulated);
+	painter.scale(scale, scale);
+	drawing->paintVectorRange(painter, true, 0, static_cast<int>(drawing->segmentsLastIter.size()) - 1);
+
+	const bool apng = settings.format == AnimationExportSettings::Format::Apng;
+	ui::ApngWriter apngWriter;
+	if (apng && !apngWriter.open(settings.fileName, frameCount, settings.frameDelayMs)) return apngWriter.errorString();
+
+	QString error;
+	QQueue<QFuture<EncodedFrame>> inFlight;
+	const auto finishOldest = [&]() {
+		const EncodedFrame encoded = inFlight.dequeue().result();
+		if (!error.isEmpty()) return;
+		if (!encoded.error.isEmpty()) {
+			error = encoded.error;
+		} else if (apng && !apngWriter.addFrame(encoded.png)) {
+			error = apngWriter.errorString();
+		}
+	};
+
+	int segEnd = 0;
+	for (int frame = 0; frame < frameCount && error.isEmpty(); ++frame) {
+		if (cancelRequested) {
+			error = "export cancelled";
+			break;
+		}
+
+		const int newSegEnd = segmentsUntilFrame(frame);
+		drawing->paintVectorRange(painter, false, segEnd, newSegEnd - 1);
+		segEnd = newSegEnd;
+
+		QImage frameImage(settings.resolution, QImage::Format_RGB32);
+		frameImage.fill(settings.backColor);
+		QPainter framePainter(&frameImage);
+		framePainter.drawImage(0, 0, accumulated);
+		framePainter.end();
+
+		if (inFlight.size() >= RingSize) finishOldest();
+		inFlight.enqueue(QtConcurrent::run(encodeFrame, frameImage, apng ? QString() : sequenceFileName(settings.fileName, frame)));
+		emit progress(frame + 1, frameCount);
+	}
+	while (!inFlight.isEmpty()) finishOldest();
+
+	if (apng) {
+		if (!error.isEmpty()) {
+			apngWriter.abort();
+		} else if (!apngWriter.finish()) {
+			error = apngWriter.errorString();
+		}
+	}
+	return error;
+}
+
+} // namespace lsystem
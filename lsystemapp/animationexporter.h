@@ -0,0 +1,60 @@
+#pragma once
+
+#include <drawing.h>
+
+#include <QFutureWatcher>
+#include <QObject>
+
+#include <atomic>
+
+namespace lsystem {
+
+struct AnimationExportSettings final
+{
+	enum class Format
+	{
+		PngSequence, // one file per frame, the frame number is appended to the base name
+		Apng
+	};
+
+	QString fileName;
+	Format format = Format::Apng;
+	int frameCount = 0;       // if not set, derived from segmentsPerFrame
+	int segmentsPerFrame = 0;
+	QSize resolution;         // the drawing is scaled to fit, keeping its aspect ratio
+	int frameDelayMs = 40;
+	QColor backColor;
+};
+
+// Exports the construction animation of a drawing in the background. The frames are rendered incrementally from the segments
+// in a worker thread and encoded to PNG on further worker threads. At most RingSize frames are in flight, the rendering waits
+// for the encoding of the oldest frame if the ring is full.
+class AnimationExporter : public QObject
+{
+	Q_OBJECT
+public:
+	static const constexpr int RingSize = 4;
+
+	AnimationExporter();
+	~AnimationExporter();
+
+	bool isActive() const { return watcher.isRunning(); }
+
+public slots:
+	void start(const QSharedPointer<lsystem::ui::Drawing> & drawing, const lsystem::AnimationExportSettings & settings);
+	void cancel();
+
+signals:
+	void progress(int frame, int frameCount);
+	// `errorString` is empty on success
+	void finished(const QString & errorString);
+
+private:
+	QString run(const QSharedPointer<ui::Drawing> & drawing, const AnimationExportSettings & settings);
+
+private:
+	QFutureWatcher<QString> watcher;
+	std::atomic_bool cancelRequested = false;
+};
+
+} // namespace lsystem
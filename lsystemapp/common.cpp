@@ -4,8 +4,12 @@
 #include <util/print.h>
 #include <util/qtcontutils.h>
 
+#include <QDir>
+#include <QStandardPaths>
 #include <QtMath>
 
+#include <limits>
+
 using namespace util;
 using namespace lsystem::constants;
 
@@ -49,6 +53,10 @@ bool LineSeg::isPoint() const { return start == end; }
 
 QPointF LineSeg::pointNegY() const { return QPoint(start.x(), -start.y()); }
 
+QLineF LineSeg::lineNegYF() const { return QLineF(start.x(), -start.y(), end.x(), -end.y()); }
+
+QPointF LineSeg::pointNegYF() const { return QPointF(start.x(), -start.y()); }
+
 // ---------------------------------------------------------------------------
 
 ConfigSet::ConfigSet(const QJsonObject & obj)
@@ -106,18 +114,176 @@ QJsonObject ConfigMap::toJson() const
 
 // ----------------------------------------------------------------------------
 
+namespace {
+
+const QString SpillFilePattern = "segments-*.segs";
+
+// not in the temp directory, which is often in memory (tmpfs)
+QString spillDirectory()
+{
+	const QString cacheLocation = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+	return cacheLocation.isEmpty() ? QString() : cacheLocation + "/spill";
+}
+
+} // namespace
+
+SegmentSpill::SegmentSpill()
+{
+	const QString directory = spillDirectory();
+	if (!directory.isEmpty() && QDir().mkpath(directory)) file.setFileTemplate(directory + "/segments-XXXXXX.segs");
+	if (!file.open()) error = "could not create a temporary file: " + file.errorString();
+	buffer.reserve(ChunkSegments);
+}
+
+void SegmentSpill::removeStaleFiles()
+{
+	// Files still used by a running instance are not affected: they can not be removed on Windows,
+	// and on other systems they stay readable through the open handle until they are closed.
+	const QString directoryName = spillDirectory();
+	if (directoryName.isEmpty()) return;
+	QDir directory(directoryName);
+	for (const QString & fileName : directory.entryList({SpillFilePattern}, QDir::Files)) directory.remove(fileName);
+}
+
+bool SegmentSpill::append(const LineSeg & seg)
+{
+	if (!error.isEmpty()) return false;
+	buffer << seg;
+	++count;
+	return buffer.size() < ChunkSegments || flush();
+}
+
+bool SegmentSpill::finish() { return error.isEmpty() && flush(); }
+
+bool SegmentSpill::flush()
+{
+	const qint64 bytes = buffer.size() * static_cast<qint64>(sizeof(LineSeg));
+	if (file.write(reinterpret_cast<const char *>(buffer.constData()), bytes) != bytes || !file.flush()) {
+		error = "could not write the segments: " + file.errorString();
+		count -= buffer.size();
+	} else if (QStorageInfo(file.fileName()).bytesAvailable() < ReservedDiskBytes) {
+		error = "not enough disk space left";
+	}
+	buffer.clear();
+	return error.isEmpty();
+}
+
+void SegmentSpill::forEachRange(qint64 start, qint64 end, const RangeCallback & callback) const
+{
+	end = qMin(end, count - buffer.size());
+	for (qint64 first = start; first < end; first += ChunkSegments) {
+		const qsizetype rangeCount = static_cast<qsizetype>(qMin<qint64>(ChunkSegments, end - first));
+		uchar * data;
+		{
+			QMutexLocker lock(&mutex);
+			data = file.map(first * sizeof(LineSeg), rangeCount * sizeof(LineSeg));
+		}
+		if (!data) return;
+		callback(reinterpret_cast<const LineSeg *>(data), rangeCount, first);
+		QMutexLocker lock(&mutex);
+		file.unmap(data);
+	}
+}
+
+// ----------------------------------------------------------------------------
+
 QString ExecResult::toString() const { return printStr("ExecResult(%1, segments: %2, iterations: %3)", resultKind, segments, iterNum); }
 
 // ----------------------------------------------------------------------------
 
+SymbolSource::SymbolSource(const QVector<Rule> & rules, const Symbol & start, quint32 depth)
+	: rules(rules)
+	, start(start)
+	, depth(depth)
+{
+	// the lengths of depth n are composed from the lengths of depth n-1, linear in the depth
+	constexpr quint64 MaxLength = std::numeric_limits<quint64>::max();
+	lengths.reserve(depth + 1);
+	lengths << QVector<quint64>(rules.size(), 1);
+	for (quint32 d = 1; d <= depth; ++d) {
+		QVector<quint64> depthLengths(rules.size(), 0);
+		for (int r = 0; r < rules.size(); ++r) {
+			quint64 & length = depthLengths[r];
+			for (const Symbol & symbol : rules[r]) {
+				const quint64 symLength = symbolLength(symbol, d - 1);
+				length = symLength > MaxLength - length ? MaxLength : length + symLength;
+			}
+		}
+		lengths << depthLengths;
+	}
+}
+
+quint64 SymbolSource::size() const { return symbolLength(start, depth); }
+
+QString SymbolSource::symbols(quint64 offset, int count) const
+{
+	QString rv;
+	if (offset >= size() || count <= 0) return rv;
+	if (start.rule < 0 || depth == 0) return QString(QChar(start.symbol));
+	rv.reserve(count);
+
+	// position within the symbols of `rule`, which are expanded with depth - 1
+	struct Frame
+	{
+		int rule;
+		quint32 depth;
+		int pos;
+	};
+	QVector<Frame> stack{Frame{start.rule, depth, 0}};
+
+	// descend to the offset, skipping complete subtrees
+	while (true) {
+		Frame & frame = stack.last();
+		const Symbol & symbol = rules[frame.rule][frame.pos];
+		const quint64 length = symbolLength(symbol, frame.depth - 1);
+		if (offset >= length) {
+			offset -= length;
+			++frame.pos;
+		} else if (symbol.rule < 0 || frame.depth == 1) {
+			break;
+		} else {
+			stack << Frame{symbol.rule, frame.depth - 1, 0};
+		}
+	}
+
+	// collect the symbols from there on
+	while (!stack.isEmpty() && rv.size() < count) {
+		Frame & frame = stack.last();
+		if (frame.pos >= rules[frame.rule].size()) {
+			stack.removeLast();
+			if (!stack.isEmpty()) ++stack.last().pos;
+			continue;
+		}
+		const Symbol & symbol = rules[frame.rule][frame.pos];
+		if (symbol.rule < 0 || frame.depth == 1) {
+			rv += QChar(symbol.symbol);
+			++frame.pos;
+		} else {
+			stack << Frame{symbol.rule, frame.depth - 1, 0};
+		}
+	}
+	return rv;
+}
+
+quint64 SymbolSource::symbolLength(const Symbol & symbol, quint32 depth) const
+{
+	return symbol.rule < 0 ? 1 : lengths[depth][symbol.rule];
+}
+
+// ----------------------------------------------------------------------------
+
 AppSettings::AppSettings(const QJsonObject & obj)
 	: maxStackSize(obj[JsonKeySettingsMaxStackSize].toInt())
+	, undoMemoryMb(obj[JsonKeySettingsUndoMemoryMb].toInt(DefaultUndoMemoryMb))
+	, pixelAccurateHitTest(obj[JsonKeySettingsPixelAccurateHitTest].toBool())
 {}
 
 QJsonObject AppSettings::toJson() const
 {
 	QJsonObject rv;
 	rv[JsonKeySettingsMaxStackSize] = static_cast<int>(maxStackSize);
+	rv[JsonKeySettingsUndoMemoryMb] = static_cast<int>(undoMemoryMb);
+	rv[JsonKeySettingsPixelAccurateHitTest] = pixelAccurateHitTest;
 	return rv;
 }
 
@@ -141,10 +307,47 @@ QColor ColorGradient::colorAt(double t) const
 
 // ----------------------------------------------------------------------------
 
+MetaData::MetaData(const QJsonObject & obj)
+	: showLastIter(obj[JsonKeyShowLastIter].toBool())
+	, lastIterOpacy(obj[JsonKeyLastIterOpacity].toDouble())
+	, thickness(obj[JsonKeyThickness].toDouble())
+	, opacity(obj[JsonKeyOpacity].toDouble())
+	, antiAliasing(obj[JsonKeyAntiAliasing].toBool())
+	, levelOfDetail(obj[JsonKeyLevelOfDetail].toBool())
+	, densityMode(obj[JsonKeyDensityMode].toBool())
+	, outOfCore(obj[JsonKeyOutOfCore].toBool())
+{
+	if (obj.contains(JsonKeyGradientStart)) {
+		colorGradient = ColorGradient();
+		colorGradient->startColor = QColor(obj[JsonKeyGradientStart].toString());
+		colorGradient->endColor = QColor(obj[JsonKeyGradientEnd].toString());
+	}
+}
+
+QJsonObject MetaData::toJson() const
+{
+	QJsonObject rv;
+
+	rv[JsonKeyShowLastIter] = showLastIter;
+	rv[JsonKeyLastIterOpacity] = lastIterOpacy;
+	rv[JsonKeyThickness] = thickness;
+	rv[JsonKeyOpacity] = opacity;
+	rv[JsonKeyAntiAliasing] = antiAliasing;
+	rv[JsonKeyLevelOfDetail] = levelOfDetail;
+	rv[JsonKeyDensityMode] = densityMode;
+	rv[JsonKeyOutOfCore] = outOfCore;
+	if (colorGradient) {
+		rv[JsonKeyGradientStart] = colorGradient->startColor.name();
+		rv[JsonKeyGradientEnd] = colorGradient->endColor.name();
+	}
+
+	return rv;
+}
+
 QString MetaData::toString() const
 {
 	return printStr("MetaData(execSegments: %1, execActionStr: %2, showLastIter: %3, lastIterOpacy: %4, thickness: %5, opacity: %6, "
-					"antiAliasing: %7, animLatency: %8)",
+					"antiAliasing: %7, animLatency: %8, levelOfDetail: %9, densityMode: %10)",
 					execSegments,
 					execActionStr,
 					showLastIter,
@@ -152,7 +355,9 @@ QString MetaData::toString() const
 					thickness,
 					opacity,
 					antiAliasing,
-					animLatency);
+					animLatency,
+					levelOfDetail,
+					densityMode);
 }
 
 // ----------------------------------------------------------------------------
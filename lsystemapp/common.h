@@ -6,6 +6,8 @@
 #include <QPointF>
 #include <QtCore>
 
+#include <functional>
+
 namespace lsystem::common {
 
 class AnimatorResultStructs final : public QObject
@@ -27,6 +29,8 @@ struct AnimatorResult final
 	using NextStepResult = AnimatorResultStructs::NextStepResult;
 	NextStepResult nextStepResult;
 	int step = 0;
+	int stepCount = 0; // number of segments of the animated drawing
+	QRect addedRect;   // canvas area of the added segments, only with AddedOnly
 };
 
 struct Definition final
@@ -61,6 +65,7 @@ struct Links final
 	static const constexpr char * NextIterations = "next_iter";
 	static const constexpr char * ShowSymbols = "show_symbols";
 	static const constexpr char * EditSettings = "show_settings";
+	static const constexpr char * OutOfCore = "out_of_core";
 };
 
 struct LineSeg final
@@ -76,10 +81,53 @@ struct LineSeg final
 	QLine lineNegY() const;
 	bool isPoint() const;
 	QPointF pointNegY() const;
+
+	// same without rounding, for rendering at zoom levels other than 1
+	QLineF lineNegYF() const;
+	QPointF pointNegYF() const;
 };
 
 using LineSegs = QList<LineSeg>;
 
+// Segments in a temporary file instead of the memory, for drawings with more segments than fit into it.
+// They are appended in chunks of ChunkSegments and read by memory-mapping the requested ranges.
+class SegmentSpill final
+{
+public:
+	static const constexpr qsizetype ChunkSegments = 1 << 16;
+	// spilling stops if less disk space is left
+	static const constexpr qint64 ReservedDiskBytes = 1ll << 30;
+
+	using RangeCallback = std::function<void(const LineSeg * segs, qsizetype count, qint64 first)>;
+
+	SegmentSpill();
+
+	// Removes the files left by instances that did not exit properly, to be called at startup.
+	static void removeStaleFiles();
+
+	// false if the file could not be written, e.g., if the disk is full
+	bool append(const LineSeg & seg);
+	bool finish();
+	qint64 size() const { return count; }
+	QString errorString() const { return error; }
+
+	// Passes the segments [start, end) in pieces of at most ChunkSegments, `first` is the index of `segs[0]`.
+	// Only after `finish`, may be called from several threads.
+	void forEachRange(qint64 start, qint64 end, const RangeCallback & callback) const;
+
+private:
+	bool flush();
+
+private:
+	mutable QTemporaryFile file;
+	mutable QMutex mutex; // mapping is not thread-safe
+	LineSegs buffer;
+	qint64 count = 0;
+	QString error;
+};
+
+using SegmentSpillPtr = QSharedPointer<const SegmentSpill>;
+
 struct ConfigSet final
 {
 	ConfigSet() = default;
@@ -159,15 +207,50 @@ struct ExecResult
 	ExecResultKind resultKind = ExecResultKind::Null;
 	common::LineSegs segments;
 	common::LineSegs segmentsLastIter;
+	SegmentSpillPtr spilledSegments; // instead of `segments` for out-of-core execution
 	quint32 iterNum = 0;
 	QVector<QColor> actionColors;
 
 	QString toString() const;
 };
 
+// Expansion of an L-system, which is never materialized as a whole. The expanded length of every rule
+// is precalculated per depth, such that any window of the symbols can be composed directly.
+class SymbolSource final
+{
+public:
+	struct Symbol
+	{
+		char symbol = '\0';
+		int rule = -1; // index of the rule which replaces the symbol, if it is a literal
+	};
+	using Rule = QVector<Symbol>;
+
+	SymbolSource(const QVector<Rule> & rules, const Symbol & start, quint32 depth);
+
+	// lengths saturate at the maximum of quint64
+	quint64 size() const;
+	QString symbols(quint64 offset, int count) const;
+
+private:
+	quint64 symbolLength(const Symbol & symbol, quint32 depth) const;
+
+private:
+	QVector<Rule> rules;
+	QVector<QVector<quint64>> lengths; // [depth][rule]
+	Symbol start;
+	quint32 depth = 0;
+};
+
+using SymbolSourcePtr = QSharedPointer<const SymbolSource>;
+
 struct AppSettings final
 {
+	static const constexpr quint32 DefaultUndoMemoryMb = 256;
+
 	quint32 maxStackSize = 0;
+	quint32 undoMemoryMb = DefaultUndoMemoryMb;
+	bool pixelAccurateHitTest = false;
 
 	AppSettings() = default;
 	AppSettings(const QJsonObject & obj);
@@ -185,6 +268,10 @@ struct ColorGradient final
 
 struct MetaData final
 {
+	MetaData() = default;
+	// only the options which determine the appearance of a drawing
+	MetaData(const QJsonObject & obj);
+	QJsonObject toJson() const;
 	QString toString() const;
 
 	bool execSegments = false;
@@ -198,6 +285,9 @@ struct MetaData final
 	std::optional<std::chrono::milliseconds> animLatency;
 	std::optional<ColorGradient> colorGradient;
 	bool maximize = false;
+	bool levelOfDetail = false;
+	bool densityMode = false;
+	bool outOfCore = false;
 };
 
 struct ConfigAndMeta
@@ -236,6 +326,8 @@ inline void registerCommonTypes()
 	qRegisterMetaType<LineSegs>("common::LineSegs");
 	qRegisterMetaType<AnimatorResult>("common::AnimatorResult");
 	qRegisterMetaType<AnimatorResult>("lsystem::common::AnimatorResult");
+	qRegisterMetaType<SymbolSourcePtr>("lsystem::common::SymbolSourcePtr");
+	qRegisterMetaType<SymbolSourcePtr>("common::SymbolSourcePtr");
 }
 
 } // namespace lsystem::common
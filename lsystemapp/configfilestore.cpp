@@ -2,6 +2,9 @@
 
 #include <jsonkeys.h>
 #include <util/print.h>
+#include <util/qtcontutils.h>
+
+#include <QSaveFile>
 
 using namespace lsystem::common;
 using namespace lsystem::constants;
@@ -10,9 +13,35 @@ using namespace util;
 namespace {
 
 const constexpr char * UserConfigFile = "config.json";
+const constexpr char * UserConfigJournalFile = "config.journal";
 const constexpr char * PredefinedConfigFile = ":/data/predefined-config.json";
+
+QString writeConfigFile(const lsystem::AppConfig & appConfig)
+{
+	QSaveFile file(UserConfigFile);
+	if (!file.open(QFile::WriteOnly)) return printStr("could not write to config file %1", QFileInfo(UserConfigFile));
+	file.write(QJsonDocument(appConfig.toJson()).toJson());
+	if (!file.commit()) return printStr("could not write to config file %1", QFileInfo(UserConfigFile));
+
+	// the journal is contained in the config file now, replaying it again would not harm
+	QFile journal(UserConfigJournalFile);
+	if (journal.exists() && !journal.open(QFile::WriteOnly | QFile::Truncate)) {
+		return printStr("could not truncate journal %1", QFileInfo(journal));
+	}
+	return QString();
+}
+
+QString appendJournalFile(const QByteArray & lines)
+{
+	QFile journal(UserConfigJournalFile);
+	if (!journal.open(QFile::WriteOnly | QFile::Append) || journal.write(lines) != lines.size() || !journal.flush()) {
+		return printStr("could not write to journal %1", QFileInfo(journal));
+	}
+	return QString();
 }
 
+} // namespace
+
 namespace lsystem {
 
 AppConfig::AppConfig(const QJsonObject & obj)
@@ -32,6 +61,25 @@ QJsonObject AppConfig::toJson() const
 
 // ------------------------------------------------------------------------------------------------------------------------
 
+ConfigFileStore::ConfigFileStore()
+{
+	writer.moveToThread(&writerThread);
+	writerThread.start();
+
+	compactionTimer.setSingleShot(true);
+	compactionTimer.setInterval(CompactionDelayMs);
+	connect(&compactionTimer, &QTimer::timeout, this, &ConfigFileStore::compact);
+}
+
+ConfigFileStore::~ConfigFileStore()
+{
+	if (compactionTimer.isActive()) compact();
+	// wait for all queued writes, they are processed in order
+	QMetaObject::invokeMethod(&writer, []() {}, Qt::BlockingQueuedConnection);
+	writerThread.quit();
+	writerThread.wait();
+}
+
 void ConfigFileStore::loadConfig()
 {
 	ConfigMap preConfigs;
@@ -53,30 +101,63 @@ void ConfigFileStore::loadConfig()
 		} else {
 			emit showError(printStr("user config file %1 could not be loaded", QFileInfo(UserConfigFile)));
 		}
-	} else {
-		saveCurrentConfig();
 	}
 
+	// changes after the last compaction (or before the first one)
+	const bool journalNonEmpty = replayJournal(currentConfig, UserConfigJournalFile);
+	if (journalNonEmpty || !QFile::exists(UserConfigFile)) compact();
+
 	emit loadedPreAndUserConfigs(preConfigs, currentConfig.configMap);
 	settingsUpdated();
 }
 
-void ConfigFileStore::saveCurrentConfig()
+void ConfigFileStore::appendJournal(const QList<QJsonObject> & entries)
 {
-	QFile file(UserConfigFile);
-	if (!file.open(QFile::WriteOnly)) {
-		emit showError(printStr("could not write to config file %1", QFileInfo(file)));
-		return;
+	if (entries.isEmpty()) return;
+
+	QByteArray lines;
+	for (const QJsonObject & entry : entries) lines += QJsonDocument(entry).toJson(QJsonDocument::Compact) + '\n';
+	QMetaObject::invokeMethod(&writer, [this, lines]() {
+		const QString error = appendJournalFile(lines);
+		if (!error.isEmpty()) QMetaObject::invokeMethod(this, [this, error]() { emit showError(error); });
+	});
+
+	journalEntries += entries.size();
+	if (journalEntries >= MaxJournalEntries) {
+		compact();
+	} else if (!compactionTimer.isActive()) {
+		compactionTimer.start();
 	}
-	QJsonDocument doc(currentConfig.toJson());
-	file.write(doc.toJson());
-	file.close();
+}
+
+void ConfigFileStore::compact()
+{
+	compactionTimer.stop();
+	journalEntries = 0;
+
+	// the copy is cheap (implicitly shared) and serialized in the writer thread
+	QMetaObject::invokeMethod(&writer, [this, appConfig = currentConfig]() {
+		const QString error = writeConfigFile(appConfig);
+		if (!error.isEmpty()) QMetaObject::invokeMethod(this, [this, error]() { emit showError(error); });
+	});
 }
 
 void ConfigFileStore::newConfigMap(const common::ConfigMap & configMap)
 {
+	// only the changed configs are journaled
+	QList<QJsonObject> entries;
+	for (const auto & [name, configSet] : KeyVal(configMap)) {
+		const auto it = currentConfig.configMap.constFind(name);
+		if (it != currentConfig.configMap.cend() && *it == configSet) continue;
+		entries << QJsonObject{
+			{JsonKeyJournalOp, JsonJournalOpStore}, {JsonKeyJournalName, name}, {JsonKeyJournalConfig, configSet.toJson()}};
+	}
+	for (const QString & name : currentConfig.configMap.keys()) {
+		if (!configMap.contains(name)) entries << QJsonObject{{JsonKeyJournalOp, JsonJournalOpRemove}, {JsonKeyJournalName, name}};
+	}
+
 	currentConfig.configMap = configMap;
-	saveCurrentConfig();
+	appendJournal(entries);
 }
 
 AppSettings ConfigFileStore::getSettings() const
@@ -87,7 +168,7 @@ AppSettings ConfigFileStore::getSettings() const
 void ConfigFileStore::saveSettings(const common::AppSettings & settings)
 {
 	currentConfig.settings = settings;
-	saveCurrentConfig();
+	appendJournal({QJsonObject{{JsonKeyJournalOp, JsonJournalOpSettings}, {JsonKeySettings, settings.toJson()}}});
 	settingsUpdated();
 }
 
@@ -111,9 +192,40 @@ AppConfig ConfigFileStore::getConfigFromFile(const QString & filePath)
 
 }
 
+bool ConfigFileStore::replayJournal(AppConfig & appConfig, const QString & filePath)
+{
+	QFile file(filePath);
+	if (!file.open(QFile::ReadOnly)) return false;
+
+	while (!file.atEnd()) {
+		// a line which is not complete was not written entirely, i.e., the last one before a crash
+		const QByteArray line = file.readLine();
+		QJsonParseError err;
+		const QJsonObject entry = QJsonDocument::fromJson(line, &err).object();
+		if (err.error != QJsonParseError::NoError) break;
+
+		const QString op = entry[JsonKeyJournalOp].toString();
+		const QString name = entry[JsonKeyJournalName].toString();
+		if (op == JsonJournalOpStore) {
+			ConfigSet & configSet = appConfig.configMap[name];
+			configSet = ConfigSet(entry[JsonKeyJournalConfig].toObject());
+			configSet.name = name;
+		} else if (op == JsonJournalOpRemove) {
+			appConfig.configMap.remove(name);
+		} else if (op == JsonJournalOpSettings) {
+			appConfig.settings = AppSettings(entry[JsonKeySettings].toObject());
+		}
+	}
+	// Also a journal with only a torn line has to be compacted (i.e., truncated),
+	// the entries appended after it would never be replayed otherwise.
+	return file.size() > 0;
+}
+
 void ConfigFileStore::settingsUpdated()
 {
 	emit newStackSize(currentConfig.settings.maxStackSize);
+	emit newUndoMemoryLimit(currentConfig.settings.undoMemoryMb);
+	emit newPixelAccurateHitTest(currentConfig.settings.pixelAccurateHitTest);
 }
 
 
@@ -3,6 +3,8 @@
 #include <common.h>
 
 #include <QAbstractListModel>
+#include <QThread>
+#include <QTimer>
 
 namespace lsystem {
 
@@ -16,10 +18,19 @@ struct AppConfig
 	QJsonObject toJson() const;
 };
 
+// Persists the user configs and settings. Every change is appended to a journal, which is compacted into the config file
+// after a while (or if it grows too long). Both are written in order by a background thread, the config file is replaced
+// atomically, so a crash never loses more than the changes which are not yet journaled.
 class ConfigFileStore : public QObject
 {
 	Q_OBJECT
 public:
+	static const constexpr int CompactionDelayMs = 5000;
+	static const constexpr int MaxJournalEntries = 1000;
+
+	ConfigFileStore();
+	~ConfigFileStore();
+
 	void loadConfig();
 	common::AppSettings getSettings() const;
 
@@ -30,15 +41,25 @@ public slots:
 signals:
 	void loadedPreAndUserConfigs(const common::ConfigMap & preConfigs, const common::ConfigMap & userConfigs);
 	void newStackSize(int newMaxStackSize);
+	void newUndoMemoryLimit(int megabytes);
+	void newPixelAccurateHitTest(bool enabled);
 	void showError(const QString & errorText);
 
 private:
-	void saveCurrentConfig();
+	void appendJournal(const QList<QJsonObject> & entries);
+	void compact();
 	static AppConfig getConfigFromFile(const QString & filePath);
+	// returns whether the journal is non-empty
+	static bool replayJournal(AppConfig & appConfig, const QString & filePath);
 	void settingsUpdated();
 
 private:
 	AppConfig currentConfig;
+	int journalEntries = 0;
+	QTimer compactionTimer;
+
+	QThread writerThread;
+	QObject writer; // lives in writerThread, the file operations are queued to it
 };
 
 } // namespace lsystem
@@ -9,9 +9,19 @@
 #include <QPainter>
 #include <QPointF>
 #include <QRectF>
+#include <QWheelEvent>
+#include <QtMath>
 
 using namespace lsystem::common;
 
+namespace {
+
+constexpr double ZoomStepFactor = 1.25;
+constexpr double MinZoom = 1. / 64;
+constexpr double MaxZoom = 256;
+
+} // namespace
+
 namespace lsystem::ui {
 
 DrawArea::DrawArea(QWidget * parent)
@@ -19,24 +29,32 @@ DrawArea::DrawArea(QWidget * parent)
 	, ctxMenu(this)
 {
 	move.menu.addAction("move to here", this, &DrawArea::moveDrawingHere);
+	connect(&renderer, &ViewportRenderer::renderingFinished, this, [this]() { update(); });
 }
 
 void DrawArea::clear()
 {
 	drawings.clearAll();
 	emit highlightChanged({});
-	update();
-	setNextUndoRedo(true);
+	updateDrawings();
 }
 
 void DrawArea::moveDrawingHere()
 {
 	if (move.mode != MoveState::MoveByMenu) return;
 
-	if (drawings.moveDrawing(drawings.getMarkedDrawingNum(), move.moveToPos, false)) update();
+	if (drawings.moveDrawing(drawings.getMarkedDrawingNum(), move.moveToPos, false)) updateDrawings();
 	move.mode = MoveState::NoMove;
 }
 
+void DrawArea::resetZoom()
+{
+	view = View();
+	renderer.cancel();
+	updateView();
+	emit highlightChanged(drawings.getHighlightedDrawResult());
+}
+
 void DrawArea::draw(const QSharedPointer<ui::Drawing> & drawing)
 {
 	drawings.addOrReplaceDrawing(drawing);
@@ -44,14 +62,31 @@ void DrawArea::draw(const QSharedPointer<ui::Drawing> & drawing)
 	// In general, the drawing dimensions changed, so the icons for the highlighted drawing have to be updated.
 	emit highlightChanged(drawings.getHighlightedDrawResult());
 
-	update();
-	setNextUndoRedo(true);
+	updateDrawings();
+}
+
+void DrawArea::setDrawings(const QList<QSharedPointer<ui::Drawing>> & newDrawings, qint64 markedDrawing)
+{
+	drawings.setDrawings(newDrawings, markedDrawing);
+	emit highlightChanged(drawings.getHighlightedDrawResult());
+	updateDrawings();
+}
+
+void DrawArea::replaceDrawing(const QSharedPointer<ui::Drawing> & oldDrawing, const QSharedPointer<ui::Drawing> & newDrawing)
+{
+	if (!drawings.replaceDrawing(oldDrawing, newDrawing)) return;
+	emit highlightChanged(drawings.getHighlightedDrawResult());
+	updateDrawings();
 }
 
 void DrawArea::copyToClipboardFull()
 {
 	QClipboard * clipboard = QGuiApplication::clipboard();
-	clipboard->setImage(drawings.getImage());
+	if (isZoomed()) {
+		clipboard->setImage(grab().toImage());
+	} else {
+		clipboard->setImage(drawings.getImage(visibleCanvasRect()));
+	}
 }
 
 void DrawArea::deleteMarked()
@@ -68,27 +103,26 @@ void DrawArea::deleteDrawing(int drawingNum)
 	const bool wasHighlighted = drawingNum == drawings.getHighlightedDrawingNum();
 	drawings.deleteDrawing(drawingNum);
 	if (wasHighlighted) emit highlightChanged({});
-	update();
-	setNextUndoRedo(true);
+	updateDrawings();
 }
 
 void DrawArea::sendToFrontMarked()
 {
 	drawings.sendToFront(drawings.getMarkedDrawingNum());
-	update();
+	updateDrawings();
 }
 
 void DrawArea::sendToBackMarked()
 {
 	drawings.sendToBack(drawings.getMarkedDrawingNum());
-	update();
+	updateDrawings();
 }
 
 void DrawArea::translateHighlighted(const QPoint & newOffset)
 {
 	if (!drawings.getHighlightedDrawingNum()) return;
 	if (drawings.moveDrawing(drawings.getHighlightedDrawingNum(), newOffset)) {
-		update();
+		updateDrawings();
 		emit highlightChanged(drawings.getHighlightedDrawResult());
 	}
 }
@@ -105,7 +139,7 @@ Drawing * DrawArea::getCurrentDrawing() { return drawings.getCurrentDrawing(); }
 void DrawArea::redrawAndUpdate(bool keepContent)
 {
 	drawings.redraw(keepContent);
-	update();
+	updateDrawings();
 	if (!keepContent && drawings.getHighlightedDrawingNum() > 0) {
 		emit highlightChanged(drawings.getHighlightedDrawResult());
 	}
@@ -120,7 +154,13 @@ AnimatorResult DrawArea::newAnimationStep(int step, bool relativeStep)
 
 	const auto res = currentDrawing->newAnimationStep(step, relativeStep);
 	if (res.nextStepResult == AnimatorResult::NextStepResult::Unchanged) return res; // no painting
-	redrawAndUpdate(res.nextStepResult == AnimatorResult::NextStepResult::AddedOnly);
+	if (res.nextStepResult == AnimatorResult::NextStepResult::AddedOnly) {
+		// only the area of the new segments is recomposited and updated
+		drawings.redrawRect(res.addedRect);
+		updateDrawings(res.addedRect);
+	} else {
+		redrawAndUpdate();
+	}
 	return res;
 }
 
@@ -138,42 +178,167 @@ void DrawArea::layerSelectionChanged(const QItemSelection & selected, const QIte
 }
 
 
+void DrawArea::updateView()
+{
+	// zoomed out, the previous viewport is kept for the preview
+	if (view.zoom >= 1) drawings.setViewport(visibleCanvasRect());
+	if (isZoomed()) renderer.start(drawings.getDrawingsInZOrder(), size(), canvasToView(), drawings.backColor);
+	update();
+}
+
+void DrawArea::updateDrawings(const QRect & changedRect)
+{
+	updateUndoRedoActions();
+
+	const QRegion dirtyRegion = drawings.takeDirtyRegion();
+	if (!isZoomed()) {
+		update(dirtyRegion.translated(-view.pan.toPoint()));
+		// the frames may have moved together with the drawings
+		updateOverlay();
+		return;
+	}
+
+	// While dragging, the preview scales the cached layers, the view is rendered again when the drag ends.
+	if (drawings.isDragging()) {
+		renderer.cancel();
+	} else if (!changedRect.isNull()) {
+		// the segments are drawn with some thickness, a pixel more avoids remainders at the border
+		const QRect viewRect = canvasToView().mapRect(QRectF(changedRect)).toAlignedRect().adjusted(-1, -1, 1, 1);
+		renderer.update(drawings.getDrawingsInZOrder(), viewRect, size(), canvasToView(), drawings.backColor);
+	} else {
+		renderer.start(drawings.getDrawingsInZOrder(), size(), canvasToView(), drawings.backColor);
+	}
+	update();
+}
+
+QTransform DrawArea::canvasToView() const { return QTransform().scale(view.zoom, view.zoom).translate(-view.pan.x(), -view.pan.y()); }
+
+QPoint DrawArea::mapToCanvas(const QPointF & pos) const
+{
+	const QPointF canvasPos = pos / view.zoom + view.pan;
+	return QPoint(qFloor(canvasPos.x()), qFloor(canvasPos.y()));
+}
+
+QPoint DrawArea::mapFromCanvas(const QPoint & pos) const { return ((QPointF(pos) - view.pan) * view.zoom).toPoint(); }
+
+QRect DrawArea::visibleCanvasRect() const { return QRect(mapToCanvas(QPointF(0, 0)), mapToCanvas(QPointF(width(), height()))); }
+
+void DrawArea::zoomAt(const QPointF & pos, double newZoom)
+{
+	newZoom = qBound(MinZoom, newZoom, MaxZoom);
+	// snap to 1:1, where the canvas image is shown directly
+	if (qAbs(newZoom - 1) < 1e-3) newZoom = 1;
+	if (newZoom == view.zoom) return;
+
+	// keep the canvas position under the cursor
+	const QPointF canvasPos = pos / view.zoom + view.pan;
+	view.zoom = newZoom;
+	view.pan = canvasPos - pos / view.zoom;
+	if (!isZoomed()) {
+		view.pan = view.pan.toPoint();
+		renderer.cancel();
+	}
+
+	updateView();
+	emit highlightChanged(drawings.getHighlightedDrawResult());
+}
+
 void DrawArea::paintEvent(QPaintEvent * event)
 {
 	QPainter painter(this);
 	QRect dirtyRect = event->rect();
-	painter.drawImage(dirtyRect, drawings.getImage(), dirtyRect);
+
+	if (!isZoomed()) {
+		const QPoint pan = view.pan.toPoint();
+		painter.save();
+		painter.translate(-pan);
+		drawings.paintCanvas(painter, dirtyRect.translated(pan));
+		painter.restore();
+	} else if ((!renderer.isActive() || renderer.isPartial()) && renderer.getTransform() == canvasToView()
+			   && !renderer.getImage().isNull()) {
+		painter.drawImage(dirtyRect, renderer.getImage(), dirtyRect);
+	} else {
+		// preview until the vector rendering of the current view is finished
+		painter.fillRect(dirtyRect, drawings.backColor);
+		painter.save();
+		painter.setTransform(canvasToView());
+		painter.setRenderHint(QPainter::SmoothPixmapTransform, view.zoom < 1);
+		drawings.paintCanvas(painter, visibleCanvasRect());
+		painter.restore();
+	}
+
+	// Overlay on top of the unchanged composite, the frames have a fixed size on screen.
+	overlay.placeholderFrames = placeholderFramesInView();
+	for (const QRect & frame : overlay.placeholderFrames) Drawing::drawPlaceholderFrame(painter, frame);
+	overlay.markedFrame = frameRectInView(drawings.getMarkedDrawingNum());
+	if (!overlay.markedFrame.isNull()) Drawing::drawFrames(painter, overlay.markedFrame, true, false);
+	overlay.highlightedFrame = frameRectInView(drawings.getHighlightedDrawingNum());
+	if (!overlay.highlightedFrame.isNull()) Drawing::drawFrames(painter, overlay.highlightedFrame, false, true);
 }
 
-void DrawArea::resizeEvent(QResizeEvent * event)
+QRect DrawArea::frameRectInView(qint64 drawingNum)
 {
-	QImage image = drawings.getImage();
-	if (width() > image.width() || height() > image.height()) {
-		// avoid always resizing, when the window size is changed
-		int newWidth = qMax(width() + 128, image.width());
-		int newHeight = qMax(height() + 128, image.height());
-		const QSize newSize(newWidth, newHeight);
-		drawings.resize(newSize);
-		update();
+	const QRect rect = drawings.getDrawingRect(drawingNum);
+	if (rect.isNull()) return QRect();
+	return QRect(mapFromCanvas(rect.topLeft()), mapFromCanvas(rect.bottomRight()));
+}
+
+QList<QRect> DrawArea::placeholderFramesInView()
+{
+	QList<QRect> rv;
+	const QRect visibleRect = visibleCanvasRect();
+	for (const QSharedPointer<Drawing> & drawing : drawings.getDrawingsInZOrder()) {
+		if (!drawing->placeholder || !drawing->canvasRect().intersects(visibleRect)) continue;
+		const QRect rect = drawing->canvasRect();
+		rv << QRect(mapFromCanvas(rect.topLeft()), mapFromCanvas(rect.bottomRight()));
+	}
+	return rv;
+}
+
+void DrawArea::updateOverlay()
+{
+	// the frames at the last painted and at the new positions
+	QList<QRect> frameRects = {overlay.markedFrame,
+							   overlay.highlightedFrame,
+							   frameRectInView(drawings.getMarkedDrawingNum()),
+							   frameRectInView(drawings.getHighlightedDrawingNum())};
+	frameRects << overlay.placeholderFrames << placeholderFramesInView();
+	for (const QRect & frameRect : frameRects) {
+		if (!frameRect.isNull()) update(Drawing::frameRegion(frameRect));
 	}
+}
+
+void DrawArea::resizeEvent(QResizeEvent * event)
+{
+	// the canvas is unbounded, only the viewport changes
+	updateView();
 	QWidget::resizeEvent(event);
 }
 
 void DrawArea::mousePressEvent(QMouseEvent * event)
 {
-	const qint64 clickedDrawing = drawings.getDrawingByPos(event->pos());
+	if (event->button() == Qt::MouseButton::MiddleButton) {
+		move.mode = MoveState::Pan;
+		move.panStartPos = event->position();
+		move.panStartOffset = view.pan;
+		setCursor(Qt::SizeAllCursor);
+		return;
+	}
+
+	const QPoint canvasPos = mapToCanvas(event->position());
+	const qint64 clickedDrawing = drawings.getDrawingByPos(canvasPos);
 
 	bool cancelEvent = false;
 
 	if (clickedDrawing > 0 && clickedDrawing == drawings.getMarkedDrawingNum() && event->button() == Qt::MouseButton::LeftButton) {
-		move.startOffset = drawings.getDrawingOffset(drawings.getMarkedDrawingNum()) - event->position().toPoint();
+		move.startOffset = drawings.getDrawingOffset(drawings.getMarkedDrawingNum()) - canvasPos;
 		move.mode = MoveState::ReadyForMove;
 		setCursor(Qt::ClosedHandCursor);
 		cancelEvent = true;
 	} else if (drawings.getMarkedDrawingNum() > 0 && clickedDrawing == 0) {
 		if (event->button() == Qt::MouseButton::RightButton) {
 			move.mode = MoveState::MoveByMenu;
-			move.moveToPos = event->position().toPoint();
+			move.moveToPos = canvasPos;
 			// note that the menu blocks the following actions
 			move.menu.exec(event->globalPosition().toPoint());
 			return;
@@ -185,32 +350,39 @@ void DrawArea::mousePressEvent(QMouseEvent * event)
 
 	if (!cancelEvent && event->button() == Qt::MouseButton::RightButton) {
 		ctxMenu.setDrawingActionsVisible(clickedDrawing > 0);
+		ctxMenu.canvasPos = canvasPos;
 		ctxMenu.menu.exec(event->globalPosition().toPoint());
 		cancelEvent = true;
 	}
 
 	// forward to main window
 	if (!cancelEvent) {
-		const auto pos = event->position().toPoint();
-		emit mouseClick(pos.x(), pos.y(), event->button(), drawings.getMarkedDrawingNum() > 0);
+		emit mouseClick(canvasPos.x(), canvasPos.y(), event->button(), drawings.getMarkedDrawingNum() > 0);
 	}
 }
 
 void DrawArea::markDrawing(int drawingNum)
 {
-	if (drawings.setMarkedDrawing(drawingNum)) {
-		update();
-	}
+	if (drawings.setMarkedDrawing(drawingNum)) updateOverlay();
 }
 
 void DrawArea::mouseReleaseEvent(QMouseEvent * event)
 {
 	Q_UNUSED(event);
 
+	if (move.mode == MoveState::Pan) {
+		setCursor(Qt::ArrowCursor);
+		move.mode = MoveState::NoMove;
+		emit highlightChanged(drawings.getHighlightedDrawResult());
+		return;
+	}
+
 	if (move.mode == MoveState::ReadyForMove || move.mode == MoveState::MoveStarted) {
 		setCursor(Qt::ArrowCursor);
-		if (move.mode == MoveState::MoveStarted && drawings.getHighlightedDrawingNum()) {
-			emit highlightChanged(drawings.getHighlightedDrawResult());
+		if (move.mode == MoveState::MoveStarted) {
+			drawings.endDrag();
+			updateDrawings();
+			if (drawings.getHighlightedDrawingNum()) emit highlightChanged(drawings.getHighlightedDrawResult());
 		}
 		move.mode = MoveState::NoMove;
 	}
@@ -218,18 +390,27 @@ void DrawArea::mouseReleaseEvent(QMouseEvent * event)
 
 void DrawArea::mouseMoveEvent(QMouseEvent * event)
 {
+	if (move.mode == MoveState::Pan) {
+		view.pan = move.panStartOffset - (event->position() - move.panStartPos) / view.zoom;
+		if (!isZoomed()) view.pan = view.pan.toPoint();
+		updateView();
+		return;
+	}
+
+	const QPoint canvasPos = mapToCanvas(event->position());
+
 	if (move.mode == MoveState::ReadyForMove || move.mode == MoveState::MoveStarted) {
 		if (move.mode == MoveState::ReadyForMove) {
-			drawings.storeUndoPoint(drawings.getMarkedDrawingNum());
-			setNextUndoRedo(true);
+			drawings.storeUndoPoint();
+			drawings.beginDrag(drawings.getMarkedDrawingNum());
 			move.mode = MoveState::MoveStarted;
 		}
-		const QPoint newOffset = move.startOffset + event->position().toPoint();
-		if (drawings.moveDrawing(drawings.getMarkedDrawingNum(), newOffset, false)) update();
+		const QPoint newOffset = move.startOffset + canvasPos;
+		if (drawings.moveDrawing(drawings.getMarkedDrawingNum(), newOffset, false)) updateDrawings();
 		setCursor(Qt::ClosedHandCursor);
 
 	} else {
-		const qint64 mouseOverDrawingNum = drawings.getDrawingByPos(event->pos());
+		const qint64 mouseOverDrawingNum = drawings.getDrawingByPos(canvasPos);
 		const bool moveCouldStart = (mouseOverDrawingNum > 0 && mouseOverDrawingNum == drawings.getMarkedDrawingNum());
 		const bool readyForPaint = (drawings.getMarkedDrawingNum() == 0 && mouseOverDrawingNum == 0);
 		setCursor(moveCouldStart ? Qt::OpenHandCursor : (readyForPaint ? Qt::CrossCursor : Qt::ArrowCursor));
@@ -237,19 +418,37 @@ void DrawArea::mouseMoveEvent(QMouseEvent * event)
 	}
 }
 
+void DrawArea::wheelEvent(QWheelEvent * event)
+{
+	const double steps = event->angleDelta().y() / 120.;
+	if (steps == 0) return;
+	zoomAt(event->position(), view.zoom * std::pow(ZoomStepFactor, steps));
+	event->accept();
+}
+
 void DrawArea::highlightDrawing(int drawingNum)
 {
 	if (drawings.highlightDrawing(drawingNum)) {
 		emit highlightChanged(drawings.getHighlightedDrawResult());
-		update();
+		updateOverlay();
 	}
 }
 
-void DrawArea::setNextUndoRedo(bool undoOrRedo)
+void DrawArea::updateUndoRedoActions()
+{
+	ctxMenu.undoAction->setEnabled(drawings.canUndo());
+	ctxMenu.redoAction->setEnabled(drawings.canRedo());
+}
+
+void DrawArea::setUndoMemoryLimit(int megabytes)
+{
+	drawings.setUndoMemoryLimit(static_cast<qint64>(megabytes) * 1024 * 1024);
+	updateUndoRedoActions();
+}
+
+void DrawArea::setPixelAccurateHitTest(bool enabled)
 {
-	nextUndoOrRedo = undoOrRedo;
-	ctxMenu.undoAction->setEnabled(undoOrRedo);
-	ctxMenu.redoAction->setEnabled(!undoOrRedo);
+	drawings.pixelAccurateHitTest = enabled;
 }
 
 void DrawArea::copyToClipboardMarked()
@@ -271,15 +470,56 @@ void DrawArea::copyToClipboardMarked()
 	} else {
 		newImage.fill(drawings.backColor);
 	}
-	painter.drawImage(QPoint(0, 0), drawings.getDrawingImage(drawings.getMarkedDrawingNum()));
+	drawings.getDrawingImage(drawings.getMarkedDrawingNum()).drawTo(painter, QPoint(0, 0));
 	clipboard->setImage(newImage);
 }
 
-void DrawArea::undoRedo()
+void DrawArea::exportAnimationMarked()
 {
-	drawings.restoreLast();
-	update();
-	setNextUndoRedo(!nextUndoOrRedo);
+	const QSharedPointer<Drawing> drawing = drawings.getDrawing(drawings.getMarkedDrawingNum());
+	if (drawing) emit exportAnimation(drawing, drawings.backColor);
+}
+
+void DrawArea::exportVectorMarked()
+{
+	const QSharedPointer<Drawing> drawing = drawings.getDrawing(drawings.getMarkedDrawingNum());
+	if (drawing) emit exportVector({drawing}, drawings.backColor);
+}
+
+void DrawArea::exportVectorFull()
+{
+	const QList<QSharedPointer<Drawing>> allDrawings = drawings.getDrawingsInZOrder();
+	if (!allDrawings.isEmpty()) emit exportVector(allDrawings, drawings.backColor);
+}
+
+void DrawArea::exportPosterMarked()
+{
+	const QSharedPointer<Drawing> drawing = drawings.getDrawing(drawings.getMarkedDrawingNum());
+	if (drawing) emit exportPoster({drawing}, drawings.backColor);
+}
+
+void DrawArea::exportPosterFull()
+{
+	const QList<QSharedPointer<Drawing>> allDrawings = drawings.getDrawingsInZOrder();
+	if (!allDrawings.isEmpty()) emit exportPoster(allDrawings, drawings.backColor);
+}
+
+void DrawArea::saveDrawingMarked()
+{
+	const QSharedPointer<Drawing> drawing = drawings.getDrawing(drawings.getMarkedDrawingNum());
+	if (drawing) emit saveDrawing(drawing);
+}
+
+void DrawArea::loadDrawingHere() { emit loadDrawing(ctxMenu.canvasPos); }
+
+void DrawArea::undo()
+{
+	if (drawings.undo()) updateDrawings();
+}
+
+void DrawArea::redo()
+{
+	if (drawings.redo()) updateDrawings();
 }
 
 void DrawArea::setBgColor()
@@ -289,7 +529,7 @@ void DrawArea::setBgColor()
 
 		drawings.backColor = col;
 		drawings.redraw();
-		update();
+		updateDrawings();
 	}
 }
 
@@ -301,14 +541,18 @@ DrawArea::ContextMenu::ContextMenu(DrawArea * parent)
 {
 	drawingActions << menu.addAction("Delete drawing", Qt::Key_Delete, parent, &DrawArea::deleteMarked)
 				   << menu.addAction("Copy drawing", Qt::CTRL | Qt::Key_C, parent, &DrawArea::copyToClipboardMarked)
+				   << menu.addAction("Export animation...", parent, &DrawArea::exportAnimationMarked)
+				   << menu.addAction("Export drawing as SVG/PDF...", parent, &DrawArea::exportVectorMarked)
+				   << menu.addAction("Export drawing as large PNG...", parent, &DrawArea::exportPosterMarked)
+				   << menu.addAction("Save drawing...", parent, &DrawArea::saveDrawingMarked)
 				   << menu.addAction("Send to front", parent, &DrawArea::sendToFrontMarked)
 				   << menu.addAction("Send to back", parent, &DrawArea::sendToBackMarked) << menu.addSeparator();
 
 	setDrawingActionsVisible(false);
 
-	undoAction = menu.addAction("Undo", Qt::CTRL | Qt::Key_Z, parent, &DrawArea::undoRedo);
+	undoAction = menu.addAction("Undo", Qt::CTRL | Qt::Key_Z, parent, &DrawArea::undo);
 	undoAction->setEnabled(false);
-	redoAction = menu.addAction("Redo", Qt::CTRL | Qt::Key_Y, parent, &DrawArea::undoRedo);
+	redoAction = menu.addAction("Redo", Qt::CTRL | Qt::Key_Y, parent, &DrawArea::redo);
 	redoAction->setEnabled(false);
 	menu.addSeparator();
 
@@ -317,6 +561,10 @@ DrawArea::ContextMenu::ContextMenu(DrawArea * parent)
 	menu.addSeparator();
 
 	menu.addAction("Copy canvas", parent, &DrawArea::copyToClipboardFull);
+	menu.addAction("Export canvas as SVG/PDF...", parent, &DrawArea::exportVectorFull);
+	menu.addAction("Export canvas as large PNG...", parent, &DrawArea::exportPosterFull);
+	menu.addAction("Load drawing...", parent, &DrawArea::loadDrawingHere);
+	menu.addAction("Reset zoom", Qt::CTRL | Qt::Key_0, parent, &DrawArea::resetZoom);
 	menu.addSeparator();
 
 	menu.addAction("Show symbols window", Qt::CTRL | Qt::SHIFT | Qt::Key_S, parent, &DrawArea::emitShowSymbols);
@@ -2,6 +2,7 @@
 
 #include <common.h>
 #include <drawingcollection.h>
+#include <viewportrenderer.h>
 
 #include <QMenu>
 #include <QWidget>
@@ -16,6 +17,8 @@ public:
 
 	void clear();
 	void draw(const QSharedPointer<ui::Drawing> & drawing);
+	void setDrawings(const QList<QSharedPointer<ui::Drawing>> & newDrawings, qint64 markedDrawing);
+	void replaceDrawing(const QSharedPointer<ui::Drawing> & oldDrawing, const QSharedPointer<ui::Drawing> & newDrawing);
 	void copyToClipboardFull();
 
 	void deleteMarked();
@@ -37,15 +40,29 @@ public:
 
 	QMenu * getContextMenu() { return &ctxMenu.menu; }
 
+	// The canvas is shown with zoom and pan, all drawing coordinates refer to the canvas.
+	QPoint mapToCanvas(const QPointF & pos) const;
+	QPoint mapFromCanvas(const QPoint & pos) const;
+	QRect visibleCanvasRect() const;
+	bool isZoomed() const { return view.zoom != 1; }
+
 public slots:
 	common::AnimatorResult newAnimationStep(int step, bool relativeStep);
 	void layerSelectionChanged(const QItemSelection & selected, const QItemSelection & deselected);
 	void moveDrawingHere();
+	void setUndoMemoryLimit(int megabytes);
+	void setPixelAccurateHitTest(bool enabled);
+	void resetZoom();
 
 signals:
 	void highlightChanged(std::optional<DrawingSummary>);
 	void mouseClick(int x, int y, Qt::MouseButton button, bool drawingMarked);
 	void showSymbols();
+	void exportAnimation(const QSharedPointer<lsystem::ui::Drawing> & drawing, const QColor & backColor);
+	void exportVector(const QList<QSharedPointer<lsystem::ui::Drawing>> & drawings, const QColor & backColor);
+	void exportPoster(const QList<QSharedPointer<lsystem::ui::Drawing>> & drawings, const QColor & backColor);
+	void saveDrawing(const QSharedPointer<lsystem::ui::Drawing> & drawing);
+	void loadDrawing(const QPoint & canvasPos);
 
 protected:
 	void paintEvent(QPaintEvent * event) override;
@@ -53,29 +70,45 @@ protected:
 	void mousePressEvent(QMouseEvent * event) override;
 	void mouseReleaseEvent(QMouseEvent * event) override;
 	void mouseMoveEvent(QMouseEvent * event) override;
+	void wheelEvent(QWheelEvent * event) override;
 
 private:
-	void setNextUndoRedo(bool undoOrRedo);
+	void updateUndoRedoActions();
 	void highlightDrawing(int drawingNum);
 	void deleteDrawing(int drawingNum);
+	void updateView();
+	// `changedRect` is the canvas area of the change if it is known, e.g., for an animation step
+	void updateDrawings(const QRect & changedRect = QRect());
+	QRect frameRectInView(qint64 drawingNum);
+	QList<QRect> placeholderFramesInView();
+	void updateOverlay();
+	void zoomAt(const QPointF & pos, double newZoom);
+	QTransform canvasToView() const;
 
 private slots:
 	void copyToClipboardMarked();
-	void undoRedo();
+	void exportAnimationMarked();
+	void exportVectorMarked();
+	void exportVectorFull();
+	void exportPosterMarked();
+	void exportPosterFull();
+	void saveDrawingMarked();
+	void loadDrawingHere();
+	void undo();
+	void redo();
 	void setBgColor();
 	void emitShowSymbols() { emit showSymbols(); }
 
 private:
 	DrawingCollection drawings;
 
-	bool nextUndoOrRedo = true;
-
 	enum class MoveState
 	{
 		NoMove,
 		ReadyForMove,
 		MoveStarted,
-		MoveByMenu
+		MoveByMenu,
+		Pan
 	};
 
 	enum class TransparencyOpt
@@ -90,9 +123,27 @@ private:
 		MoveState mode = MoveState::NoMove;
 		QPoint moveToPos;
 		QPoint startOffset;
+		QPointF panStartPos;
+		QPointF panStartOffset;
 		QMenu menu;
 	} move;
 
+	struct View final
+	{
+		double zoom = 1;
+		QPointF pan; // canvas position at the top left corner of the widget
+	} view;
+
+	ViewportRenderer renderer;
+
+	struct Overlay final
+	{
+		// frames in widget coordinates, as painted last
+		QRect markedFrame;
+		QRect highlightedFrame;
+		QList<QRect> placeholderFrames;
+	} overlay;
+
 	class ContextMenu final
 	{
 	public:
@@ -102,6 +153,7 @@ private:
 		QAction * redoAction;
 		void setDrawingActionsVisible(bool visible);
 		bool getTransparencyForExport(bool * ok);
+		QPoint canvasPos; // where the menu was opened
 
 	private:
 		DrawArea * const drawArea;
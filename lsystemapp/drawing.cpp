@@ -1,7 +1,252 @@
 #include "drawing.h"
 
+#include <QtConcurrent>
+
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
 using namespace lsystem::common;
 
+namespace {
+
+using lsystem::ui::TiledImage;
+
+// Below this number of segments per thread, the density is accumulated in less threads.
+constexpr int MinDensitySegmentsPerThread = 10000;
+constexpr int DensityLutSize = 256;
+// Maximum number of distinct colors of a gradient, finer steps are not visible.
+constexpr int MaxGradientLutSize = 1024;
+// Memory for the animation checkpoints of a single drawing. If exceeded, every second checkpoint is dropped.
+constexpr qint64 CheckpointMemoryBudget = 64 * 1024 * 1024;
+constexpr int MinCheckpointInterval = 256;
+
+using DensityTile = lsystem::ui::Drawing::DensityTile;
+using DensityBuffer = lsystem::ui::Drawing::DensityBuffer;
+
+DensityBuffer accumulateDensity(const LineSeg * segs, qsizetype count, const QPoint & topLeft)
+{
+	DensityBuffer buffer;
+	QPoint lastTileIndex;
+	quint32 * lastTile = nullptr;
+
+	const auto hit = [&](int x, int y) {
+		if (x < 0 || y < 0) return;
+		const QPoint tileIndex(x / TiledImage::TileSize, y / TiledImage::TileSize);
+		if (!lastTile || tileIndex != lastTileIndex) {
+			DensityTile & tile = buffer[tileIndex];
+			if (tile.isEmpty()) tile.fill(0, TiledImage::TileSize * TiledImage::TileSize);
+			lastTile = tile.data();
+			lastTileIndex = tileIndex;
+		}
+		++lastTile[(y % TiledImage::TileSize) * TiledImage::TileSize + x % TiledImage::TileSize];
+	};
+
+	for (qsizetype i = 0; i < count; ++i) {
+		const QLine ln = segs[i].lineNegY() - topLeft;
+		const int steps = qMax(qAbs(ln.dx()), qAbs(ln.dy()));
+		if (steps == 0) {
+			hit(ln.x1(), ln.y1());
+			continue;
+		}
+		// The end pixel is the start pixel of the next connected segment, count it only once.
+		const double stepX = static_cast<double>(ln.dx()) / steps;
+		const double stepY = static_cast<double>(ln.dy()) / steps;
+		for (int k = 0; k < steps; ++k) hit(ln.x1() + qRound(k * stepX), ln.y1() + qRound(k * stepY));
+	}
+
+	return buffer;
+}
+
+void mergeDensity(DensityBuffer & density, const DensityBuffer & other)
+{
+	for (auto it = other.cbegin(); it != other.cend(); ++it) {
+		DensityTile & tile = density[it.key()];
+		if (tile.isEmpty()) {
+			tile = it.value();
+			continue;
+		}
+		const quint32 * src = it.value().constData();
+		for (quint32 & count : tile) count += *src++;
+	}
+}
+
+// Accumulates the hit counts in parallel, every thread has its own sparse buffer.
+DensityBuffer calcDensity(const LineSeg * segs, qsizetype numSegs, const QPoint & topLeft)
+{
+	const int numThreads = qBound(1, static_cast<int>(numSegs / MinDensitySegmentsPerThread), QThread::idealThreadCount());
+	const qsizetype chunkSize = (numSegs + numThreads - 1) / numThreads;
+
+	QList<QFuture<DensityBuffer>> futures;
+	for (qsizetype start = 0; start < numSegs; start += chunkSize) {
+		const qsizetype count = qMin(chunkSize, numSegs - start);
+		futures << QtConcurrent::run([segs, start, count, topLeft]() { return accumulateDensity(segs + start, count, topLeft); });
+	}
+	if (futures.isEmpty()) return {};
+
+	DensityBuffer density = futures.first().result();
+	for (qsizetype i = 1; i < futures.size(); ++i) mergeDensity(density, futures[i].result());
+	return density;
+}
+
+// Tone mapping: logarithmic density, colored by the gradient or faded in with the first color.
+void paintDensity(TiledImage & image,
+				  const DensityBuffer & density,
+				  const QVector<QColor> & actionColors,
+				  const lsystem::ui::Drawing::InternalMeta & meta)
+{
+	quint32 maxCount = 0;
+	for (const DensityTile & tile : density) {
+		for (quint32 count : tile) maxCount = qMax(maxCount, count);
+	}
+	if (maxCount == 0) return;
+
+	const QColor baseColor = actionColors.isEmpty() ? QColor(0, 0, 0) : actionColors.first();
+	QVector<QRgb> lut(DensityLutSize);
+	for (int i = 0; i < DensityLutSize; ++i) {
+		const double t = static_cast<double>(i) / (DensityLutSize - 1);
+		const QColor color = meta.colorGradient ? meta.colorGradient->colorAt(t) : baseColor;
+		const double alpha = meta.colorGradient ? meta.opacityFactor : t * meta.opacityFactor;
+		lut[i] = qPremultiply(qRgba(color.red(), color.green(), color.blue(), qRound(alpha * 255)));
+	}
+
+	const double lutFct = (DensityLutSize - 1) / std::log1p(static_cast<double>(maxCount));
+	for (auto it = density.cbegin(); it != density.cend(); ++it) {
+		QImage densityImage(TiledImage::TileSize, TiledImage::TileSize, TiledImage::TileFormat);
+		const quint32 * count = it.value().constData();
+		for (int y = 0; y < TiledImage::TileSize; ++y) {
+			QRgb * line = reinterpret_cast<QRgb *>(densityImage.scanLine(y));
+			for (int x = 0; x < TiledImage::TileSize; ++x, ++count) {
+				line[x] = *count ? lut[qRound(std::log1p(static_cast<double>(*count)) * lutFct)] : qRgba(0, 0, 0, 0);
+			}
+		}
+		QPainter painter(&image.tile(it.key()));
+		painter.drawImage(QPoint(0, 0), densityImage);
+	}
+}
+
+// Paints on a TiledPainter (drawing image with pixel-aligned lines, shifted by `shift`)
+// or on a QPainter (vector rendering in drawing coordinates with sub-pixel precision).
+// `first` is the index of `segs[0]` among all `totalSegs` segments, for the color gradient.
+template<typename Painter>
+void paintSegments(Painter & painter,
+				   const LineSeg * segs,
+				   qsizetype count,
+				   qint64 first,
+				   qint64 totalSegs,
+				   const lsystem::ui::Drawing::InternalMeta & meta,
+				   const QVector<QColor> & actionColors,
+				   const QPoint & shift)
+{
+	if (meta.antiAliasing) painter.setRenderHint(QPainter::Antialiasing);
+	QPen pen;
+	pen.setWidthF(meta.thickness);
+	pen.setCapStyle(Qt::RoundCap);
+
+	QVector<QColor> drawColors;
+	for (QColor actionColorCopy : actionColors) {
+		actionColorCopy.setAlphaF(meta.opacityFactor);
+		drawColors.push_back(actionColorCopy);
+	}
+
+	int lastColorNum = -1;
+	const qsizetype lutSize = meta.gradientLut.size();
+
+	for (qsizetype i = 0; i < count; ++i) {
+		const LineSeg & seg = segs[i];
+
+		if (meta.colorGradient) {
+			// color gradient mode, consecutive segments with the same color share the pen
+			const int lutIndex = static_cast<int>((first + i) * lutSize / totalSegs);
+			if (lutIndex != lastColorNum) {
+				pen.setColor(QColor::fromRgba(meta.gradientLut[lutIndex]));
+				lastColorNum = lutIndex;
+				painter.setPen(pen); // this is necessary after setColor!
+			}
+		} else if (static_cast<int>(seg.colorNum) != lastColorNum) {
+			// use colors from the config, which were written to the segments
+			pen.setColor(drawColors.at(seg.colorNum));
+			lastColorNum = seg.colorNum;
+			painter.setPen(pen); // this is necessary after setColor!
+		}
+
+		if constexpr (std::is_same_v<Painter, QPainter>) {
+			if (seg.isPoint()) {
+				painter.drawPoint(seg.pointNegYF());
+			} else {
+				painter.drawLine(seg.lineNegYF());
+			}
+		} else {
+			if (seg.isPoint()) {
+				painter.drawPoint(seg.pointNegY() - shift);
+			} else {
+				painter.drawLine(seg.lineNegY() - shift);
+			}
+		}
+	}
+}
+
+// Quantized gradient with the opacity applied, indexed by segNum * size / numSegs.
+// For up to MaxGradientLutSize segments there is one exact entry per segment.
+QVector<QRgb> calcGradientLut(const ColorGradient & gradient, double opacityFactor, qsizetype numSegs)
+{
+	const int lutSize = static_cast<int>(qBound<qsizetype>(1, numSegs, MaxGradientLutSize));
+	QVector<QRgb> rv(lutSize);
+	for (int i = 0; i < lutSize; ++i) {
+		QColor color = gradient.colorAt(static_cast<double>(i) / lutSize);
+		if (opacityFactor < 1) color.setAlphaF(opacityFactor);
+		rv[i] = color.rgba();
+	}
+	return rv;
+}
+
+// bounds of the segments including the pen width
+QRectF calcBounds(const LineSeg * segs, qsizetype count, double thickness)
+{
+	const double margin = thickness / 2. + 1;
+	double minX = segs[0].start.x(), maxX = minX;
+	double minY = -segs[0].start.y(), maxY = minY;
+	for (qsizetype i = 0; i < count; ++i) {
+		const QLineF ln = segs[i].lineNegYF();
+		minX = qMin(minX, qMin(ln.x1(), ln.x2()));
+		maxX = qMax(maxX, qMax(ln.x1(), ln.x2()));
+		minY = qMin(minY, qMin(ln.y1(), ln.y2()));
+		maxY = qMax(maxY, qMax(ln.y1(), ln.y2()));
+	}
+	return QRectF(QPointF(minX, minY), QPointF(maxX, maxY)).adjusted(-margin, -margin, margin, margin);
+}
+
+void appendChunkBounds(QVector<QRectF> & bounds, const LineSeg * segs, qsizetype count, int chunkSize, double thickness)
+{
+	for (qsizetype start = 0; start < count; start += chunkSize) {
+		bounds << calcBounds(segs + start, qMin<qsizetype>(chunkSize, count - start), thickness);
+	}
+}
+
+int calcCheckpointInterval(qsizetype numSegs, qint64 imageBytes)
+{
+	// rough estimate: checkpoints are partially painted images which compress well
+	const qint64 estimatedBytes = qMax<qint64>(imageBytes / 8, 1);
+	const qint64 count = qMax<qint64>(CheckpointMemoryBudget / estimatedBytes, 1);
+	return qMax(MinCheckpointInterval, static_cast<int>((numSegs + count - 1) / count));
+}
+
+QByteArray compressTile(const QImage & tile)
+{
+	return qCompress(QByteArray::fromRawData(reinterpret_cast<const char *>(tile.constBits()), tile.sizeInBytes()), 1);
+}
+
+QImage uncompressTile(const QByteArray & data)
+{
+	const QByteArray raw = qUncompress(data);
+	QImage rv(TiledImage::TileSize, TiledImage::TileSize, TiledImage::TileFormat);
+	if (raw.size() != rv.sizeInBytes()) return QImage();
+	std::memcpy(rv.bits(), raw.constData(), raw.size());
+	return rv;
+}
+
+} // namespace
+
 namespace lsystem::ui {
 
 DrawingFrameSummary DrawingFrame::toDrawingFrameSummary()
@@ -9,11 +254,11 @@ DrawingFrameSummary DrawingFrame::toDrawingFrameSummary()
 	return DrawingFrameSummary{.topLeft = topLeft + offset, .botRight = botRight + offset, .offset = offset, .config = config};
 }
 
-void DrawingFrame::expandSizeToSegments(const common::LineSegs & segs, double thickness)
+void DrawingFrame::expandSizeToSegments(const LineSeg * segs, qsizetype count, double thickness)
 {
 	const int off = qCeil(thickness / 2.);
-	for (const LineSeg & seg : segs) {
-		const QLine ln = seg.lineNegY();
+	for (qsizetype i = 0; i < count; ++i) {
+		const QLine ln = segs[i].lineNegY();
 		// clang-format off
 		updateRect(qMin(ln.x1(), ln.x2()) - off, qMin(ln.y1(), ln.y2()) - off,
 				   qMax(ln.x1(), ln.x2()) + off, qMax(ln.y1(), ln.y2()) + off);
@@ -37,8 +282,14 @@ DrawingFrame::DrawingFrame(const ExecResult & execResult, const QSharedPointer<A
 	, metaData(data->meta)
 	, paintLastIter(!execResult.segmentsLastIter.isEmpty() && metaData.lastIterOpacy > 0)
 {
-	if (paintLastIter) expandSizeToSegments(execResult.segmentsLastIter, metaData.thickness);
-	expandSizeToSegments(execResult.segments, metaData.thickness);
+	const LineSegs & segsLastIter = execResult.segmentsLastIter;
+	if (paintLastIter) expandSizeToSegments(segsLastIter.constData(), segsLastIter.size(), metaData.thickness);
+	expandSizeToSegments(execResult.segments.constData(), execResult.segments.size(), metaData.thickness);
+	if (execResult.spilledSegments) {
+		execResult.spilledSegments->forEachRange(0, execResult.spilledSegments->size(), [&](const LineSeg * segs, qsizetype count, qint64) {
+			expandSizeToSegments(segs, count, metaData.thickness);
+		});
+	}
 }
 
 // ----------------------------------------------------------
@@ -47,41 +298,119 @@ Drawing::Drawing(const ExecResult & execResult, const QSharedPointer<AllDrawData
 	: DrawingFrame(execResult, data)
 	, num(data->uiDrawData.drawingNumToEdit.value_or(0))
 	, segments(execResult.segments)
+	, spilledSegments(execResult.spilledSegments)
 	, actionColors(execResult.actionColors)
 {
+	if (paintLastIter) segmentsLastIter = execResult.segmentsLastIter;
+	// the spill ranges are multiples of the chunk size
+	forEachSegmentRange(false, 0, segmentCount(), [&](const LineSeg * segs, qsizetype count, qint64) {
+		appendChunkBounds(chunkBounds, segs, count, ChunkSize, metaData.thickness);
+	});
+	appendChunkBounds(lastIterChunkBounds, segmentsLastIter.constData(), segmentsLastIter.size(), ChunkSize, metaData.thickness);
+
 	const QPoint pSize = botRight - topLeft + QPoint(1, 1);
-	image = QImage(QSize(pSize.x(), pSize.y()), QImage::Format_ARGB32);
-	image.fill(qRgba(0, 0, 0, 0)); // transparent
+	// sparse, tiles are allocated where segments are painted
+	image = TiledImage(QSize(pSize.x(), pSize.y()));
 
 	InternalMeta meta;
 	meta.antiAliasing = metaData.antiAliasing;
 	meta.thickness = metaData.thickness;
+	meta.densityMode = metaData.densityMode;
 	meta.colorGradient = metaData.colorGradient;
 
 	if (paintLastIter) {
 		lastIterMeta = meta;
 		lastIterMeta->opacityFactor = metaData.lastIterOpacy;
+		if (meta.colorGradient) {
+			lastIterMeta->gradientLut = calcGradientLut(*meta.colorGradient, lastIterMeta->opacityFactor, segmentsLastIter.size());
+		}
 		drawSegments(execResult.segmentsLastIter, *lastIterMeta);
 		lastIterImage = image;
 	}
 	mainMeta = meta;
 	mainMeta.opacityFactor = metaData.opacity;
-	drawSegments(segments, mainMeta);
+	if (meta.colorGradient) mainMeta.gradientLut = calcGradientLut(*meta.colorGradient, mainMeta.opacityFactor, segmentCount());
+	if (spilledSegments) {
+		drawSpilledSegments(mainMeta);
+		return;
+	}
+
+	// The checkpoints are stored already while drawing, such that any seek is bounded by the interval.
+	// The density is tone-mapped as a whole, it has no checkpoints.
+	checkpoints.interval = calcCheckpointInterval(segments.size(), static_cast<qint64>(pSize.x()) * pSize.y() * sizeof(QRgb));
+	if (mainMeta.densityMode) {
+		drawSegments(segments, mainMeta);
+	} else {
+		drawAnimationRange(0, segments.size() - 1);
+	}
+}
+
+QSharedPointer<Drawing> Drawing::createPlaceholder(const QSharedPointer<AllDrawData> & data, const QRect & bounds)
+{
+	auto rv = QSharedPointer<Drawing>::create(ExecResult{ExecResult::ExecResultKind::Ok}, data);
+	rv->placeholder = true;
+	rv->topLeft = bounds.topLeft();
+	rv->botRight = bounds.bottomRight();
+	// no tiles are allocated, the frame is painted as overlay by the draw area
+	rv->image = TiledImage(bounds.size());
+	return rv;
+}
+
+void Drawing::drawSegments(const LineSegs & segs, const InternalMeta & meta)
+{
+	if (meta.densityMode) {
+		drawDensity(segs, segs.size() - 1, meta);
+	} else {
+		drawSegmentRange(segs, 0, segs.size() - 1, meta);
+	}
+}
+
+void Drawing::drawSpilledSegments(const InternalMeta & meta)
+{
+	// one range after the other, only the current one is mapped
+	const qint64 numSegs = spilledSegments->size();
+	if (meta.densityMode) {
+		DensityBuffer density;
+		spilledSegments->forEachRange(0, numSegs, [&](const LineSeg * segs, qsizetype count, qint64) {
+			mergeDensity(density, calcDensity(segs, count, topLeft));
+		});
+		paintDensity(image, density, actionColors, meta);
+	} else {
+		TiledPainter painter(image);
+		spilledSegments->forEachRange(0, numSegs, [&](const LineSeg * segs, qsizetype count, qint64 first) {
+			paintSegments(painter, segs, count, first, numSegs, meta, actionColors, topLeft);
+		});
+	}
 }
 
-void Drawing::drawSegments(const LineSegs & segs, const InternalMeta & meta) { drawSegmentRange(segs, 0, segs.size() - 1, meta); }
+qint64 Drawing::segmentCount() const { return spilledSegments ? spilledSegments->size() : segments.size(); }
 
-void Drawing::drawToImage(QImage & dstImage, bool isMarked, bool isHighlighted)
+void Drawing::forEachSegmentRange(bool lastIter, qint64 start, qint64 end, const SegmentSpill::RangeCallback & callback) const
+{
+	if (!lastIter && spilledSegments) {
+		spilledSegments->forEachRange(start, end, callback);
+		return;
+	}
+	const LineSegs & segs = lastIter ? segmentsLastIter : segments;
+	end = qMin<qint64>(end, segs.size());
+	if (start < end) callback(segs.constData() + start, end - start, start);
+}
+
+void Drawing::drawTo(QPainter & painter, const QRect & clipRect)
+{
+	if (!canvasRect().intersects(clipRect)) return;
+	image.drawTo(painter, offset + topLeft, clipRect);
+}
+
+void Drawing::drawFrames(QPainter & painter, const QRect & rect, bool isMarked, bool isHighlighted)
 {
-	QPainter painter(&dstImage);
-	painter.drawImage(offset + topLeft, image);
 	if (isMarked) {
 		QPen pen;
 		pen.setColor(QColor(0, 0, 255, 50));
 		pen.setDashPattern({3, 3});
 		pen.setWidth(2);
 		painter.setPen(pen);
-		painter.drawRect(QRect(offset + topLeft, offset + botRight));
+		painter.drawRect(rect);
 	}
 	if (isHighlighted) {
 		QPen pen;
@@ -89,13 +418,45 @@ void Drawing::drawToImage(QImage & dstImage, bool isMarked, bool isHighlighted)
 		pen.setWidth(1);
 		painter.setPen(pen);
 		QPoint dist(2, 2);
-		painter.drawRect(QRect(offset + topLeft - dist, offset + botRight + dist));
+		painter.drawRect(QRect(rect.topLeft() - dist, rect.bottomRight() + dist));
 	}
 }
 
+void Drawing::drawPlaceholderFrame(QPainter & painter, const QRect & rect)
+{
+	painter.setPen(QPen(QColor(0, 0, 0, 40)));
+	painter.setBrush(Qt::NoBrush);
+	painter.drawRect(rect);
+}
+
+QRegion Drawing::frameRegion(const QRect & rect)
+{
+	// the frames cover a few pixels around the border of `rect`
+	const int margin = 3;
+	return QRegion(rect.adjusted(-margin, -margin, margin, margin)).subtracted(QRegion(rect.adjusted(margin, margin, -margin, -margin)));
+}
+
+qint64 Drawing::memoryUsage() const
+{
+	// the tiles of the last iteration image are partially shared with the main image, count them anyway
+	return (segments.size() + segmentsLastIter.size()) * static_cast<qint64>(sizeof(LineSeg))
+		   + (chunkBounds.size() + lastIterChunkBounds.size()) * static_cast<qint64>(sizeof(QRectF)) + image.memoryUsage()
+		   + lastIterImage.memoryUsage() + checkpoints.memory
+		   + animState.density.size() * static_cast<qint64>(TiledImage::TileSize * TiledImage::TileSize * sizeof(quint32));
+}
+
 QPoint Drawing::size() const { return botRight - topLeft; }
 
-bool Drawing::withinArea(const QPoint & pos) { return pos >= topLeft + offset && pos <= botRight + offset; }
+bool Drawing::hitsPixel(const QPoint & pos, int tolerance) const
+{
+	const QPoint imagePos = pos - offset - topLeft;
+	for (int dy = -tolerance; dy <= tolerance; ++dy) {
+		for (int dx = -tolerance; dx <= tolerance; ++dx) {
+			if (qAlpha(image.pixel(imagePos + QPoint(dx, dy))) > 0) return true;
+		}
+	}
+	return false;
+}
 
 DrawingSummary Drawing::toDrawingSummary()
 {
@@ -103,70 +464,134 @@ DrawingSummary Drawing::toDrawingSummary()
 	static_cast<DrawingFrameSummary &>(rv) = toDrawingFrameSummary();
 	rv.drawingNum = num;
 	rv.listIndex = listIndex;
-	rv.segmentsCount = static_cast<int>(segments.count());
-	rv.animStep = animState.inProgress ? animState.curSeg + 1 : static_cast<int>(segments.count());
+	rv.segmentsCount = static_cast<int>(qMin<qint64>(segmentCount(), std::numeric_limits<int>::max()));
+	rv.animStep = animState.inProgress ? animState.curSeg + 1 : rv.segmentsCount;
 	return rv;
 }
 
 void Drawing::drawSegmentRange(const common::LineSegs & segs, int numStart, int numEnd, const InternalMeta & meta)
 {
-	QPainter painter(&image);
+	TiledPainter painter(image);
+	paintSegments(painter, segs.constData() + numStart, numEnd - numStart + 1, numStart, segs.size(), meta, actionColors, topLeft);
 
-	if (meta.antiAliasing) painter.setRenderHint(QPainter::Antialiasing);
-	QPen pen;
-	pen.setWidthF(meta.thickness);
-	pen.setCapStyle(Qt::RoundCap);
+	animState.curSeg = numEnd;
+}
 
-	QVector<QColor> drawColors;
-	for (QColor actionColorCopy : actionColors) {
-		actionColorCopy.setAlphaF(meta.opacityFactor);
-		drawColors.push_back(actionColorCopy);
+int Drawing::vectorChunkCount() const
+{
+	// density images have no vector representation, they are painted as a whole
+	if (mainMeta.densityMode) return 1;
+	return static_cast<int>(lastIterChunkBounds.size() + chunkBounds.size());
+}
+
+void Drawing::paintVectorChunk(QPainter & painter, int chunk, const QRectF & clipRect) const
+{
+	if (mainMeta.densityMode) {
+		image.drawTo(painter, offset + topLeft);
+		return;
 	}
 
-	int lastColorNum = -1;
+	const bool lastIter = chunk < lastIterChunkBounds.size();
+	if (!lastIter) chunk -= static_cast<int>(lastIterChunkBounds.size());
+	const QRectF & bounds = lastIter ? lastIterChunkBounds[chunk] : chunkBounds[chunk];
+	if (!bounds.translated(offset).intersects(clipRect)) return;
+
+	const qint64 numSegs = lastIter ? segmentsLastIter.size() : segmentCount();
+	// during an animation only the segments up to the current step are shown
+	const qint64 numEnd = lastIter || !animState.inProgress ? numSegs - 1 : animState.curSeg;
+	const qint64 numStart = static_cast<qint64>(chunk) * ChunkSize;
+	if (numStart > numEnd) return;
+
+	painter.save();
+	painter.translate(offset);
+	paintVectorSegments(painter, lastIter, numStart, qMin(numStart + ChunkSize - 1, numEnd));
+	painter.restore();
+}
 
-	const auto itStart = segs.cbegin() + numStart;
-	const auto itEnd = segs.cbegin() + numEnd + 1;
+void Drawing::paintVectorRange(QPainter & painter, bool lastIter, qint64 numStart, qint64 numEnd) const
+{
+	if (numStart > numEnd) return;
+	painter.save();
+	painter.translate(-topLeft);
+	paintVectorSegments(painter, lastIter, numStart, numEnd);
+	painter.restore();
+}
 
-	for (auto it = itStart; it != itEnd; ++it) {
-		const auto & seg = *it;
+void Drawing::paintVectorSegments(QPainter & painter, bool lastIter, qint64 numStart, qint64 numEnd) const
+{
+	const qint64 numSegs = lastIter ? segmentsLastIter.size() : segmentCount();
+	if (numSegs == 0) return;
+	const InternalMeta & meta = lastIter ? *lastIterMeta : mainMeta;
+	forEachSegmentRange(lastIter, numStart, numEnd + 1, [&](const LineSeg * segs, qsizetype count, qint64 first) {
+		paintSegments(painter, segs, count, first, numSegs, meta, actionColors, QPoint());
+	});
+}
 
-		if (meta.colorGradient) {
-			// color gradient mode
-			const double normalizedSegNum = static_cast<double>(it - segs.cbegin()) / static_cast<double>(segs.size());
-			auto color = meta.colorGradient->colorAt(normalizedSegNum);
-			if (meta.opacityFactor < 1) color.setAlphaF(meta.opacityFactor);
-			pen.setColor(color);
-			painter.setPen(pen); // this is necessary after setColor!
-		} else if (static_cast<int>(seg.colorNum) != lastColorNum) {
-			// use colors from the config, which were written to the segments
-			pen.setColor(drawColors.at(seg.colorNum));
-			lastColorNum = seg.colorNum;
-			painter.setPen(pen); // this is necessary after setColor!
-		}
+void Drawing::forEachPolyline(bool lastIter, int maxPoints, const std::function<void(QRgb, const QPolygonF &)> & callback) const
+{
+	const qint64 numSegs = lastIter ? segmentsLastIter.size() : segmentCount();
+	if (numSegs == 0) return;
+	const InternalMeta & meta = lastIter ? *lastIterMeta : mainMeta;
 
-		if (seg.isPoint()) {
-			painter.drawPoint(seg.pointNegY() - topLeft);
-		} else {
-			painter.drawLine(seg.lineNegY() - topLeft);
+	QVector<QRgb> drawColors;
+	for (QColor actionColorCopy : actionColors) {
+		actionColorCopy.setAlphaF(meta.opacityFactor);
+		drawColors.push_back(actionColorCopy.rgba());
+	}
+	const qsizetype lutSize = meta.gradientLut.size();
+
+	QPolygonF polyline;
+	QRgb color = 0;
+	forEachSegmentRange(lastIter, 0, numSegs, [&](const LineSeg * segs, qsizetype count, qint64 first) {
+		for (qsizetype i = 0; i < count; ++i) {
+			const QLineF ln = segs[i].lineNegYF();
+			const QRgb segColor = meta.colorGradient ? meta.gradientLut[(first + i) * lutSize / numSegs] : drawColors.at(segs[i].colorNum);
+			if (!polyline.isEmpty()
+				&& (segColor != color || qAlpha(color) != 255 || polyline.last() != ln.p1() || polyline.size() >= maxPoints)) {
+				callback(color, polyline);
+				polyline.clear();
+			}
+			if (polyline.isEmpty()) {
+				polyline << ln.p1();
+				color = segColor;
+			}
+			polyline << ln.p2();
 		}
+	});
+	callback(color, polyline);
+}
+
+void Drawing::drawDensity(const common::LineSegs & segs, int numEnd, const InternalMeta & meta)
+{
+	// Only the segments added since the last step are accumulated, the tone mapping needs the new maximum anyway.
+	if (numEnd < animState.densitySeg) {
+		animState.density.clear();
+		animState.densitySeg = -1;
 	}
+	const int numStart = animState.densitySeg + 1;
+	mergeDensity(animState.density, calcDensity(segs.constData() + numStart, numEnd + 1 - numStart, topLeft));
+	animState.densitySeg = numEnd;
 
+	paintDensity(image, animState.density, actionColors, meta);
 	animState.curSeg = numEnd;
 
-	usesOpacity = (mainMeta.opacityFactor > 0 && mainMeta.opacityFactor < 1)
-				  || (lastIterMeta.has_value() && lastIterMeta->opacityFactor > 0 && lastIterMeta->opacityFactor < 1);
+	if (!animState.inProgress) {
+		animState.density.clear();
+		animState.densitySeg = -1;
+	}
 }
 
 void Drawing::drawBasicImage()
 {
-	image.fill(qRgba(0, 0, 0, 0));
-	QPainter painter(&image);
-	if (lastIterMeta.has_value()) painter.drawImage(QPoint(0, 0), lastIterImage);
+	// tiles are implicitly shared, the last iteration is only copied when painted over
+	image = lastIterMeta.has_value() ? lastIterImage : TiledImage(image.size());
 }
 
 AnimatorResult Drawing::newAnimationStep(int step, bool relativeStep)
 {
+	// the spilled segments are painted only as a whole, placeholders have nothing to animate
+	if (spilledSegments || placeholder) return AnimatorResult{.nextStepResult = AnimatorResult::NextStepResult::Stopped};
+
 	bool restarted = false;
 	const int lastStep = animState.curSeg + 1;
 	int newStep = 0;
@@ -181,7 +606,9 @@ AnimatorResult Drawing::newAnimationStep(int step, bool relativeStep)
 		newStep = relativeStep ? lastStep + step : step;
 
 		if (newStep == lastStep) {
-			return AnimatorResult{.nextStepResult = AnimatorResult::NextStepResult::Unchanged, .step = newStep};
+			return AnimatorResult{.nextStepResult = AnimatorResult::NextStepResult::Unchanged,
+								  .step = newStep,
+								  .stepCount = static_cast<int>(segments.size())};
 		}
 	}
 
@@ -195,17 +622,31 @@ AnimatorResult Drawing::newAnimationStep(int step, bool relativeStep)
 		newStep = maxStep;
 	}
 
-	if (restarted) drawBasicImage();
-
 	if (stopped) animState.inProgress = false;
 
-	// If not restarted, we only draw the additional segments.
+	// If not restarted, we only draw the additional segments. The drawing image accumulates all segments drawn so far,
+	// every segment is blended exactly once, so translucent drawings look exactly like after a full redraw.
 	const int newSeg = newStep - 1;
-	const int firstSegToDraw = restarted ? 0 : animState.curSeg;
+	int firstSegToDraw = restarted ? 0 : animState.curSeg + 1;
+	const int firstAddedSeg = firstSegToDraw;
+
+	// Seeking: continue from the nearest checkpoint if it is ahead of the current image.
+	const int checkpointStep = mainMeta.densityMode ? 0 : restoreCheckpoint(newStep, firstSegToDraw);
+	if (checkpointStep > 0) {
+		firstSegToDraw = checkpointStep;
+	} else if (restarted || mainMeta.densityMode) {
+		// The density is normalized by its maximum, so the image is tone-mapped again from the basic image at every step.
+		drawBasicImage();
+	}
+
 	// This runs in the same thread as the main UI. It would be difficult to parallelize this,
 	// as we would have to wait for the drawing to be completed anyway before we could refresh the DrawArea widget.
 	// The widget itself has to run in the same thread as the main UI (widgets are not allowed to be in a own thread in Qt).
-	drawSegmentRange(segments, firstSegToDraw, newSeg, mainMeta);
+	if (mainMeta.densityMode) {
+		drawDensity(segments, newSeg, mainMeta);
+	} else {
+		drawAnimationRange(firstSegToDraw, newSeg);
+	}
 
 	animState.curSeg = newSeg;
 
@@ -215,13 +656,88 @@ AnimatorResult Drawing::newAnimationStep(int step, bool relativeStep)
 	} else if (restarted) {
 		rv.nextStepResult = AnimatorResult::NextStepResult::Restart;
 	} else {
-		// The optimization that the contents are kept is only available if opacity is disabled.
-		rv.nextStepResult = usesOpacity ? AnimatorResult::NextStepResult::Restart : AnimatorResult::NextStepResult::AddedOnly;
+		// The canvas recomposites the drawing image between the layers below and above, also with opacity,
+		// but only in the area of the added segments.
+		rv.nextStepResult = AnimatorResult::NextStepResult::AddedOnly;
+		if (mainMeta.densityMode) {
+			// all touched tiles changed with the new maximum
+			QRect densityRect;
+			for (auto it = animState.density.cbegin(); it != animState.density.cend(); ++it) {
+				densityRect |= QRect(it.key() * TiledImage::TileSize, QSize(TiledImage::TileSize, TiledImage::TileSize));
+			}
+			rv.addedRect = densityRect.translated(offset + topLeft).intersected(canvasRect());
+		} else if (firstAddedSeg <= newSeg) {
+			rv.addedRect = calcBounds(segments.constData() + firstAddedSeg, newSeg + 1 - firstAddedSeg, mainMeta.thickness)
+							   .translated(offset)
+							   .toAlignedRect();
+		}
 	}
 
 	rv.step = newStep;
+	rv.stepCount = maxStep;
 
 	return rv;
 }
 
+void Drawing::drawAnimationRange(int numStart, int numEnd)
+{
+	// split the range at the checkpoints and store missing ones on the way
+	int start = numStart;
+	while (start <= numEnd) {
+		const int nextCheckpoint = (start / checkpoints.interval + 1) * checkpoints.interval;
+		const int end = qMin(numEnd, nextCheckpoint - 1);
+		drawSegmentRange(segments, start, end, mainMeta);
+		if (end == nextCheckpoint - 1 && nextCheckpoint < segments.size() && !checkpoints.entries.contains(nextCheckpoint)) {
+			storeCheckpoint(nextCheckpoint);
+		}
+		start = end + 1;
+	}
+}
+
+void Drawing::storeCheckpoint(int step)
+{
+	// unchanged tiles are still shared with the basic image
+	const TiledImage basicImage = lastIterMeta.has_value() ? lastIterImage : TiledImage();
+	QHash<QPoint, QByteArray> tiles;
+	qint64 size = 0;
+	for (auto it = image.tiles().cbegin(); it != image.tiles().cend(); ++it) {
+		const auto basicIt = basicImage.tiles().constFind(it.key());
+		if (basicIt != basicImage.tiles().cend() && basicIt->constBits() == it->constBits()) continue;
+		const QByteArray & data = tiles.insert(it.key(), compressTile(*it)).value();
+		size += data.size();
+	}
+
+	// thin out the checkpoints until the new one fits into the budget
+	while (checkpoints.memory + size > CheckpointMemoryBudget && !checkpoints.entries.isEmpty()) {
+		checkpoints.interval *= 2;
+		for (auto it = checkpoints.entries.begin(); it != checkpoints.entries.end();) {
+			if (it.key() % checkpoints.interval == 0) {
+				++it;
+				continue;
+			}
+			for (const QByteArray & data : std::as_const(*it)) checkpoints.memory -= data.size();
+			it = checkpoints.entries.erase(it);
+		}
+	}
+	if (step % checkpoints.interval != 0 || checkpoints.memory + size > CheckpointMemoryBudget) return;
+
+	checkpoints.entries.insert(step, tiles);
+	checkpoints.memory += size;
+}
+
+int Drawing::restoreCheckpoint(int maxStep, int minStep)
+{
+	auto it = checkpoints.entries.upperBound(maxStep);
+	if (it == checkpoints.entries.begin()) return 0;
+	--it;
+	if (it.key() <= minStep) return 0;
+
+	drawBasicImage();
+	for (auto tileIt = it->cbegin(); tileIt != it->cend(); ++tileIt) {
+		const QImage tile = uncompressTile(tileIt.value());
+		if (!tile.isNull()) image.setTile(tileIt.key(), tile);
+	}
+	return it.key();
+}
+
 } // namespace lsystem::ui
@@ -1,10 +1,14 @@
 #pragma once
 
 #include <common.h>
+#include <util/tiledimage.h>
 
 #include <QImage>
+#include <QMap>
 #include <QPainter>
+#include <QRegion>
 
+#include <functional>
 #include <optional>
 
 namespace lsystem::ui {
@@ -30,6 +34,7 @@ class DrawingFrame
 public:
 	DrawingFrame(const common::ExecResult & execResult, const QSharedPointer<common::AllDrawData> & configAndMeta);
 	DrawingFrameSummary toDrawingFrameSummary();
+	const common::MetaData & meta() const { return metaData; }
 
 	QPoint offset;
 	common::ConfigSet config;
@@ -41,7 +46,7 @@ protected:
 	QPoint botRight;
 
 private:
-	void expandSizeToSegments(const common::LineSegs & segs, double thickness);
+	void expandSizeToSegments(const common::LineSeg * segs, qsizetype count, double thickness);
 	void updateRect(double minX, double minY, double maxX, double maxY);
 };
 
@@ -49,43 +54,104 @@ class Drawing final : public DrawingFrame
 {
 public:
 	Drawing(const common::ExecResult & execResult, const QSharedPointer<common::AllDrawData> & metaData);
-	void drawToImage(QImage & dstImage, bool isMarked, bool isHighlighted);
+	// Frame with the given bounds (drawing coordinates) until the segments are available, e.g., when restoring a session.
+	static QSharedPointer<Drawing> createPlaceholder(const QSharedPointer<common::AllDrawData> & data, const QRect & bounds);
+	void drawTo(QPainter & painter, const QRect & clipRect);
+
+	// marking and highlight frames, painted as overlay around `rect`
+	static void drawFrames(QPainter & painter, const QRect & rect, bool isMarked, bool isHighlighted);
+	static void drawPlaceholderFrame(QPainter & painter, const QRect & rect);
+	static QRegion frameRegion(const QRect & rect);
 	QPoint size() const;
-	bool withinArea(const QPoint & pos);
+	// whether a painted pixel of the drawing is within `tolerance` of `pos` (canvas coordinates)
+	bool hitsPixel(const QPoint & pos, int tolerance) const;
 	DrawingSummary toDrawingSummary();
 
 	common::AnimatorResult newAnimationStep(int step, bool relativeStep);
 	void drawBasicImage();
 
+	// Vector rendering in canvas coordinates, e.g., for zoomed views. The segments are split into chunks
+	// (last iteration first) with precalculated bounds, chunks outside of `clipRect` are skipped.
+	int vectorChunkCount() const;
+	void paintVectorChunk(QPainter & painter, int chunk, const QRectF & clipRect) const;
+	// Vector rendering of the segments [numStart, numEnd] in image coordinates, independent of the animation state.
+	// Only reads the segments and metadata, which are not changed after construction, so it may run in another thread.
+	void paintVectorRange(QPainter & painter, bool lastIter, qint64 numStart, qint64 numEnd) const;
+	// Connected segments of the same opaque color merged to polylines of at most `maxPoints` points, in drawing coordinates,
+	// e.g., for vector export. Translucent segments are passed one by one, such that overlaps blend as in the drawing image.
+	void forEachPolyline(bool lastIter, int maxPoints, const std::function<void(QRgb color, const QPolygonF & polyline)> & callback) const;
+	QRect canvasRect() const { return QRect(offset + topLeft, offset + botRight); }
+	qint64 memoryUsage() const;
+
+	// Number of segments, also for out-of-core drawings.
+	qint64 segmentCount() const;
+	// Passes the segments [start, end) in one or more ranges, from the memory or from the spill file.
+	void forEachSegmentRange(bool lastIter, qint64 start, qint64 end, const common::SegmentSpill::RangeCallback & callback) const;
+
 public:
+	// Hit counts per pixel, for every tile of the drawing image which is touched.
+	using DensityTile = QVector<quint32>;
+	using DensityBuffer = QHash<QPoint, DensityTile>;
+
 	struct InternalMeta
 	{
 		double opacityFactor = 0;
 		double thickness = 0;
 		bool antiAliasing = false;
+		bool densityMode = false;
 		std::optional<lsystem::common::ColorGradient> colorGradient;
+		QVector<QRgb> gradientLut; // only with colorGradient
 	};
 
 	qint64 num = 0;
 	qint64 zIndex = 0;
 	int listIndex = 0;
+	bool placeholder = false;
+	static const constexpr int ChunkSize = 1024;
+
 	common::LineSegs segments;
+	common::LineSegs segmentsLastIter;
+	// instead of `segments` for out-of-core drawings, which have no animation and no last iteration
+	common::SegmentSpillPtr spilledSegments;
+	QVector<QRectF> chunkBounds;
+	QVector<QRectF> lastIterChunkBounds;
 	QVector<QColor> actionColors;
-	QImage lastIterImage;
-	QImage image;
+	TiledImage lastIterImage;
+	TiledImage image;
 	InternalMeta mainMeta;
 	std::optional<InternalMeta> lastIterMeta;
-	bool usesOpacity = false;
 
 	struct AnimState final
 	{
 		bool inProgress = false;
 		int curSeg = 0; // index of the last segment which was painted
+		// density mode: hit counts up to `densitySeg`, kept while the animation is in progress
+		DensityBuffer density;
+		int densitySeg = -1;
 	} animState;
 
 private:
 	void drawSegments(const common::LineSegs & segs, const InternalMeta & meta);
+	void drawSpilledSegments(const InternalMeta & meta);
 	void drawSegmentRange(const common::LineSegs & segs, int numStart, int numEnd, const InternalMeta & meta);
+	void drawDensity(const common::LineSegs & segs, int numEnd, const InternalMeta & meta);
+	void paintVectorSegments(QPainter & painter, bool lastIter, qint64 numStart, qint64 numEnd) const;
+
+	// animation seeking
+	void drawAnimationRange(int numStart, int numEnd);
+	void storeCheckpoint(int step);
+	int restoreCheckpoint(int maxStep, int minStep);
+
+private:
+	// Compressed snapshots of the drawing image during the animation, every `interval` segments.
+	// Only tiles which differ from the basic image are stored. They are recorded by the initial draw and again when the
+	// animation passes them after they were thinned out, a seek continues from the nearest checkpoint instead of segment 0.
+	struct Checkpoints final
+	{
+		int interval = 0;
+		qint64 memory = 0;
+		QMap<int, QHash<QPoint, QByteArray>> entries; // step -> compressed tiles
+	} checkpoints;
 };
 
 } // namespace lsystem::ui
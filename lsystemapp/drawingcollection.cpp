@@ -2,6 +2,13 @@
 
 using namespace lsystem::common;
 
+namespace {
+
+// distance in pixels within which a click still hits a line
+constexpr int HitTolerancePx = 3;
+
+} // namespace
+
 namespace lsystem::ui {
 
 void DrawingCollection::addOrReplaceDrawing(const QSharedPointer<Drawing> & newDrawing)
@@ -14,55 +21,156 @@ void DrawingCollection::addOrReplaceDrawing(const QSharedPointer<Drawing> & newD
 		zIndexToDrawing[newDrawing->zIndex] = newDrawing->num;
 	} else {
 		// replace drawing, keep zIndex
-		storeUndoPoint(newDrawing->num);
+		storeUndoPoint();
 		newDrawing->zIndex = drawings[newDrawing->num]->zIndex;
 	}
 
+	if (drawings.contains(newDrawing->num)) invalidate(drawings[newDrawing->num]->canvasRect(), true);
 	drawings[newDrawing->num] = newDrawing;
+	drawingGrid.insert(newDrawing->num, newDrawing->canvasRect());
+	invalidate(newDrawing->canvasRect(), true);
 
-	if (newDrawing->num == 0) {
-		newDrawing->drawToImage(image, false, false);
-	} else {
-		redraw();
+	setMarkedDrawing(newDrawing->num);
+
+	limitUndoMemory();
+	updateListData();
+}
+
+void DrawingCollection::setDrawings(const QList<QSharedPointer<Drawing>> & newDrawings, qint64 newMarkedDrawing)
+{
+	undoHistory.clear();
+	redoHistory.clear();
+
+	drawings.clear();
+	qint64 zIndex = 0;
+	for (const QSharedPointer<Drawing> & drawing : newDrawings) {
+		drawing->zIndex = ++zIndex;
+		drawings.insert(drawing->num, drawing);
 	}
 
-	setMarkedDrawing(newDrawing->num);
+	updateZIndexToDrawing();
+	updateDrawingGrid();
+	invalidateAll();
+	highlightedDrawing = 0;
+	markedDrawing = drawings.contains(newMarkedDrawing) ? newMarkedDrawing : 0;
+	emit markingChanged();
+	updateListData();
+}
+
+bool DrawingCollection::replaceDrawing(const QSharedPointer<Drawing> & oldDrawing, const QSharedPointer<Drawing> & newDrawing)
+{
+	newDrawing->num = oldDrawing->num;
+	newDrawing->zIndex = oldDrawing->zIndex;
+	newDrawing->offset = oldDrawing->offset;
+
+	// the history entries keep their own offsets and z-indices
+	for (QList<UndoEntry> * history : {&undoHistory, &redoHistory}) {
+		for (UndoEntry & entry : *history) {
+			for (UndoEntry::DrawingState & state : entry.drawings) {
+				if (state.drawing == oldDrawing) state.drawing = newDrawing;
+			}
+		}
+	}
+
+	if (drawings.value(oldDrawing->num) != oldDrawing) return false;
 
+	invalidate(oldDrawing->canvasRect(), true);
+	drawings[newDrawing->num] = newDrawing;
+	drawingGrid.insert(newDrawing->num, newDrawing->canvasRect());
+	invalidate(newDrawing->canvasRect(), true);
+
+	// e.g., the number of segments changed
+	if (newDrawing->num == markedDrawing) emit markingChanged();
 	updateListData();
+	return true;
+}
+
+void DrawingCollection::storeUndoPoint()
+{
+	undoHistory << currentUndoEntry();
+	redoHistory.clear();
 }
 
-void DrawingCollection::storeUndoPoint(std::optional<int> numToCopy)
+bool DrawingCollection::undo()
 {
-	// very simple 1-step undo
-	lastDrawings = drawings;
+	if (undoHistory.isEmpty()) return false;
+	redoHistory << currentUndoEntry();
+	restoreUndoEntry(undoHistory.takeLast());
+	return true;
+}
 
-	if (numToCopy.has_value()) {
-		lastDrawings[numToCopy.value()] = QSharedPointer<Drawing>::create(*drawings[numToCopy.value()]);
+bool DrawingCollection::redo()
+{
+	if (redoHistory.isEmpty()) return false;
+	undoHistory << currentUndoEntry();
+	restoreUndoEntry(redoHistory.takeLast());
+	return true;
+}
+
+void DrawingCollection::setUndoMemoryLimit(qint64 bytes)
+{
+	undoMemoryLimit = bytes;
+	limitUndoMemory();
+}
+
+DrawingCollection::UndoEntry DrawingCollection::currentUndoEntry() const
+{
+	UndoEntry rv;
+	for (const auto & drawing : drawings) {
+		rv.drawings.insert(drawing->num, UndoEntry::DrawingState{.drawing = drawing, .offset = drawing->offset, .zIndex = drawing->zIndex});
 	}
+	return rv;
 }
 
-void DrawingCollection::restoreLast()
+void DrawingCollection::restoreUndoEntry(const UndoEntry & entry)
 {
-	qSwap(drawings, lastDrawings);
+	drawings.clear();
+	for (const UndoEntry::DrawingState & state : entry.drawings) {
+		// offset and z-index are the only properties of a drawing which are changed in place
+		state.drawing->offset = state.offset;
+		state.drawing->zIndex = state.zIndex;
+		drawings.insert(state.drawing->num, state.drawing);
+	}
 
 	updateZIndexToDrawing();
+	updateDrawingGrid();
+	invalidateAll();
+	if (highlightedDrawing > 0 && !drawings.contains(highlightedDrawing)) highlightedDrawing = 0;
 	if (markedDrawing > 0 && !drawings.contains(markedDrawing)) {
-		// Remove marking. Calls redraw.
+		// Remove marking.
 		setMarkedDrawing(0);
 	} else {
 		emit markingChanged();
-		redraw();
 	}
 	updateListData();
 }
 
-void DrawingCollection::resize(const QSize & newSize)
+void DrawingCollection::limitUndoMemory()
 {
-	QImage newImage(newSize, QImage::Format_RGB32);
-	newImage.fill(backColor);
-	QPainter painter(&newImage);
-	painter.drawImage(QPoint(0, 0), image);
-	image = newImage;
+	// Only drawings which are not on the canvas anymore cost memory, the others are shared.
+	// Called after a change is applied, such that replaced or deleted drawings are counted.
+	QSet<const Drawing *> onCanvas;
+	for (const auto & drawing : std::as_const(drawings)) onCanvas.insert(drawing.get());
+
+	QHash<const Drawing *, int> references;
+	qint64 memory = 0;
+	for (const QList<UndoEntry> * history : {&undoHistory, &redoHistory}) {
+		for (const UndoEntry & entry : *history) {
+			for (const UndoEntry::DrawingState & state : entry.drawings) {
+				const Drawing * drawing = state.drawing.get();
+				if (!onCanvas.contains(drawing) && references[drawing]++ == 0) memory += drawing->memoryUsage();
+			}
+		}
+	}
+
+	// the last step is always kept
+	while (undoHistory.size() > 1 && memory > undoMemoryLimit) {
+		for (const UndoEntry::DrawingState & state : std::as_const(undoHistory.first().drawings)) {
+			const Drawing * drawing = state.drawing.get();
+			if (!onCanvas.contains(drawing) && --references[drawing] == 0) memory -= drawing->memoryUsage();
+		}
+		undoHistory.removeFirst();
+	}
 }
 
 void DrawingCollection::clearAll()
@@ -75,33 +183,227 @@ void DrawingCollection::clearAll()
 	highlightedDrawing = 0;
 	drawings.clear();
 	zIndexToDrawing.clear();
+	drawingGrid.clear();
 
-	image.fill(backColor);
+	limitUndoMemory();
+	invalidateAll();
 }
 
 void DrawingCollection::redraw(bool keepContent)
 {
 	dirty = false;
 
-	if (!keepContent) image.fill(backColor);
+	if (!keepContent) {
+		invalidateAll();
+		return;
+	}
+
+	// only the current drawing changed, it is composited between the cached layers
+	if (const Drawing * drawing = getCurrentDrawing()) invalidate(drawing->canvasRect(), false);
+}
+
+void DrawingCollection::redrawRect(const QRect & rect)
+{
+	dirty = false;
+
+	Drawing * drawing = getCurrentDrawing();
+	if (!drawing) return;
+	if (drawing->num != layers.activeDrawing) {
+		invalidate(rect, false);
+		return;
+	}
+
+	// Recomposite only the changed part of the cached tiles, missing tiles are composited when they are painted.
+	dirtyRegion += rect;
+	const QRect range = TiledImage::tileIndexRange(rect);
+	for (int ty = range.top(); ty <= range.bottom(); ++ty) {
+		for (int tx = range.left(); tx <= range.right(); ++tx) {
+			const QPoint tileIndex(tx, ty);
+			if (!image.hasTile(tileIndex)) continue;
+			const QRect tileRect = TiledImage::tileRect(tileIndex);
+			const QRect partRect = rect.intersected(tileRect);
+			QPainter painter(&image.tile(tileIndex));
+			painter.translate(-tileRect.topLeft());
+			painter.setClipRect(partRect);
+			painter.setCompositionMode(QPainter::CompositionMode_Source);
+			painter.drawImage(tileRect.topLeft(), belowLayerTile(tileIndex));
+			painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+			drawing->drawTo(painter, partRect);
+			if (const QImage * aboveTile = aboveLayerTile(tileIndex)) painter.drawImage(tileRect.topLeft(), *aboveTile);
+		}
+	}
+}
+
+void DrawingCollection::setViewport(const QRect & rect)
+{
+	viewport = rect;
+
+	// keep a margin of one tile, such that small pans do not recomposite
+	const QRect keepRange = TiledImage::tileIndexRange(rect).adjusted(-1, -1, 1, 1);
+	for (TiledImage * tiles : {&image, &layers.below, &layers.above}) {
+		QList<QPoint> outside;
+		for (auto it = tiles->tiles().cbegin(); it != tiles->tiles().cend(); ++it) {
+			if (!keepRange.contains(it.key())) outside << it.key();
+		}
+		for (const QPoint & tileIndex : std::as_const(outside)) tiles->removeTile(tileIndex);
+	}
+	layers.aboveDone.removeIf([&keepRange](const QPoint & tileIndex) { return !keepRange.contains(tileIndex); });
+}
+
+QRegion DrawingCollection::takeDirtyRegion()
+{
+	const QRegion rv = dirtyRegion.intersected(viewport);
+	dirtyRegion = QRegion();
+	return rv;
+}
+
+void DrawingCollection::paintCanvas(QPainter & painter, const QRect & rect)
+{
+	if (dragDrawing && drawings.contains(dragDrawing)) {
+		paintCanvasDragging(painter, rect);
+		return;
+	}
+
+	const QRect range = TiledImage::tileIndexRange(rect.intersected(viewport));
+	for (int ty = range.top(); ty <= range.bottom(); ++ty) {
+		for (int tx = range.left(); tx <= range.right(); ++tx) {
+			const QPoint tileIndex(tx, ty);
+			if (!image.hasTile(tileIndex)) compositeTile(tileIndex);
+			painter.drawImage(TiledImage::tileRect(tileIndex).topLeft(), image.tile(tileIndex));
+		}
+	}
+}
+
+void DrawingCollection::paintCanvasDragging(QPainter & painter, const QRect & rect)
+{
+	// Blit the cached layers and the dragged drawing in between, no tile is recomposited.
+	const QRect paintRect = rect.intersected(viewport);
+	const QRect range = TiledImage::tileIndexRange(paintRect);
+	for (int ty = range.top(); ty <= range.bottom(); ++ty) {
+		for (int tx = range.left(); tx <= range.right(); ++tx) {
+			const QPoint tileIndex(tx, ty);
+			painter.drawImage(TiledImage::tileRect(tileIndex).topLeft(), belowLayerTile(tileIndex));
+		}
+	}
+	drawings[dragDrawing]->drawTo(painter, paintRect);
+	for (int ty = range.top(); ty <= range.bottom(); ++ty) {
+		for (int tx = range.left(); tx <= range.right(); ++tx) {
+			const QPoint tileIndex(tx, ty);
+			const QImage * aboveTile = aboveLayerTile(tileIndex);
+			if (aboveTile) painter.drawImage(TiledImage::tileRect(tileIndex).topLeft(), *aboveTile);
+		}
+	}
+}
 
+QImage DrawingCollection::getImage(const QRect & rect)
+{
+	QImage rv(rect.size(), QImage::Format_RGB32);
+	rv.fill(backColor);
+	QPainter painter(&rv);
+	painter.translate(-rect.topLeft());
+	paintCanvas(painter, rect);
+	return rv;
+}
+
+void DrawingCollection::compositeTile(const QPoint & tileIndex)
+{
+	const qint64 active = getCurrentDrawing() ? getCurrentDrawing()->num : 0;
+	if (active != layers.activeDrawing) {
+		clearLayers();
+		layers.activeDrawing = active;
+	}
+
+	const QRect tileRect = TiledImage::tileRect(tileIndex);
+	QPainter painter(&image.tile(tileIndex));
+	painter.setCompositionMode(QPainter::CompositionMode_Source);
+	painter.drawImage(QPoint(0, 0), belowLayerTile(tileIndex));
+	painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+	painter.translate(-tileRect.topLeft());
+	if (active) drawings[active]->drawTo(painter, tileRect);
+	if (const QImage * aboveTile = aboveLayerTile(tileIndex)) painter.drawImage(tileRect.topLeft(), *aboveTile);
+}
+
+const QImage & DrawingCollection::belowLayerTile(const QPoint & tileIndex)
+{
+	if (layers.below.hasTile(tileIndex)) return layers.below.tile(tileIndex);
+
+	QImage & tile = layers.below.tile(tileIndex);
+	tile.fill(backColor);
+	const QRect tileRect = TiledImage::tileRect(tileIndex);
+	QPainter painter(&tile);
+	painter.translate(-tileRect.topLeft());
 	for (qint64 drawNum : std::as_const(zIndexToDrawing)) {
-		drawings[drawNum]->drawToImage(image, !keepContent && drawNum == markedDrawing, !keepContent && drawNum == highlightedDrawing);
+		if (drawNum == layers.activeDrawing) break;
+		drawings[drawNum]->drawTo(painter, tileRect);
+	}
+	return tile;
+}
+
+const QImage * DrawingCollection::aboveLayerTile(const QPoint & tileIndex)
+{
+	if (layers.aboveDone.contains(tileIndex)) return layers.above.hasTile(tileIndex) ? &layers.above.tile(tileIndex) : nullptr;
+	layers.aboveDone.insert(tileIndex);
+	if (layers.activeDrawing == 0) return nullptr;
+
+	const QRect tileRect = TiledImage::tileRect(tileIndex);
+	std::optional<QPainter> painter;
+	auto it = zIndexToDrawing.find(drawings[layers.activeDrawing]->zIndex);
+	for (++it; it != zIndexToDrawing.end(); ++it) {
+		const Drawing & drawing = *drawings[it.value()];
+		if (!drawing.canvasRect().intersects(tileRect)) continue;
+		if (!painter) {
+			// tiles are only allocated where drawings are above
+			painter.emplace(&layers.above.tile(tileIndex));
+			painter->translate(-tileRect.topLeft());
+		}
+		drawings[it.value()]->drawTo(*painter, tileRect);
 	}
+	return painter ? &layers.above.tile(tileIndex) : nullptr;
+}
+
+void DrawingCollection::invalidate(const QRect & rect, bool inLayers)
+{
+	dirtyRegion += rect;
+
+	const QRect range = TiledImage::tileIndexRange(rect);
+	for (TiledImage * tiles : {&image, &layers.below, &layers.above}) {
+		if (tiles != &image && !inLayers) continue;
+		const QList<QPoint> tileIndices = tiles->tiles().keys();
+		for (const QPoint & tileIndex : tileIndices) {
+			if (range.contains(tileIndex)) tiles->removeTile(tileIndex);
+		}
+	}
+	if (inLayers) layers.aboveDone.removeIf([&range](const QPoint & tileIndex) { return range.contains(tileIndex); });
+}
+
+void DrawingCollection::invalidateAll()
+{
+	dirtyRegion = QRegion(viewport);
+	image.clear();
+	clearLayers();
+}
+
+void DrawingCollection::clearLayers()
+{
+	// while dragging, the layers are always split at the dragged drawing
+	layers.activeDrawing = dragDrawing ? dragDrawing : -1;
+	layers.below.clear();
+	layers.above.clear();
+	layers.aboveDone.clear();
 }
 
 qint64 DrawingCollection::getDrawingByPos(const QPoint & pos)
 {
-	if (zIndexToDrawing.isEmpty()) return 0;
-	auto it = zIndexToDrawing.end();
-	while (true) {
-		it--;
-		const qint64 drawNum = it.value();
-		if (drawings[drawNum]->withinArea(pos)) return drawNum;
-		if (it == zIndexToDrawing.begin()) break;
+	// topmost drawing among the few candidates from the grid cell
+	qint64 rv = 0;
+	for (qint64 drawNum : drawingGrid.itemsAt(pos)) {
+		const Drawing & drawing = *drawings[drawNum];
+		if (rv > 0 && drawing.zIndex < drawings[rv]->zIndex) continue;
+		if (pixelAccurateHitTest && !drawing.hitsPixel(pos, HitTolerancePx)) continue;
+		rv = drawNum;
 	}
 
-	return 0;
+	return rv;
 }
 
 QPoint DrawingCollection::getDrawingOffset(qint64 drawingNum)
@@ -116,9 +418,20 @@ QPoint DrawingCollection::getDrawingSize(qint64 drawingNum)
 	return drawings[drawingNum]->size();
 }
 
-QImage & DrawingCollection::getDrawingImage(qint64 drawingNum) { return drawings[drawingNum]->image; }
+QRect DrawingCollection::getDrawingRect(qint64 drawingNum)
+{
+	if (!drawings.contains(drawingNum)) return QRect();
+	return drawings[drawingNum]->canvasRect();
+}
+
+const TiledImage & DrawingCollection::getDrawingImage(qint64 drawingNum) { return drawings[drawingNum]->image; }
 
-QImage DrawingCollection::getImage() { return image; }
+QList<QSharedPointer<Drawing>> DrawingCollection::getDrawingsInZOrder() const
+{
+	QList<QSharedPointer<Drawing>> rv;
+	for (qint64 drawNum : zIndexToDrawing) rv << drawings[drawNum];
+	return rv;
+}
 
 Drawing * DrawingCollection::getCurrentDrawing()
 {
@@ -136,8 +449,6 @@ bool DrawingCollection::setMarkedDrawing(qint64 newMarkedDrawing)
 
 	markedDrawing = newMarkedDrawing;
 	emit markingChanged();
-
-	redraw();
 	return true;
 }
 
@@ -145,25 +456,66 @@ bool DrawingCollection::moveDrawing(qint64 drawingNum, const QPoint & newOffset,
 {
 	if (!drawings.contains(drawingNum) || drawings[drawingNum]->offset == newOffset) return false;
 
-	if (storeUndo) storeUndoPoint(drawingNum);
+	if (storeUndo) storeUndoPoint();
 
+	if (drawingNum == dragDrawing) {
+		// the composite is left untouched while dragging, see paintCanvas; the grid is updated in endDrag
+		const QRect oldRect = drawings[drawingNum]->canvasRect();
+		drawings[drawingNum]->offset = newOffset;
+		dirtyRegion += oldRect.united(drawings[drawingNum]->canvasRect());
+		return true;
+	}
+
+	// the active drawing is not part of the cached layers
+	const bool inLayers = drawingNum != layers.activeDrawing;
+	invalidate(drawings[drawingNum]->canvasRect(), inLayers);
 	drawings[drawingNum]->offset = newOffset;
-	redraw();
+	drawingGrid.insert(drawingNum, drawings[drawingNum]->canvasRect());
+	invalidate(drawings[drawingNum]->canvasRect(), inLayers);
 	updateListData();
 	return true;
 }
 
+void DrawingCollection::beginDrag(qint64 drawingNum)
+{
+	if (!drawings.contains(drawingNum)) return;
+
+	dragDrawing = drawingNum;
+	dragStartRect = drawings[drawingNum]->canvasRect();
+	// the layers below and above the dragged drawing stay valid during the whole drag
+	if (layers.activeDrawing != drawingNum) {
+		clearLayers();
+		layers.activeDrawing = drawingNum;
+	}
+}
+
+void DrawingCollection::endDrag()
+{
+	if (!dragDrawing || !drawings.contains(dragDrawing)) {
+		dragDrawing = 0;
+		return;
+	}
+
+	drawingGrid.insert(dragDrawing, drawings[dragDrawing]->canvasRect());
+	invalidate(dragStartRect, false);
+	invalidate(drawings[dragDrawing]->canvasRect(), false);
+	dragDrawing = 0;
+	updateListData();
+}
+
 bool DrawingCollection::deleteDrawing(qint64 drawingNum)
 {
 	if (!drawings.contains(drawingNum)) return false;
 
 	storeUndoPoint();
+	invalidate(drawings[drawingNum]->canvasRect(), true);
 	zIndexToDrawing.remove(drawings[drawingNum]->zIndex);
+	drawingGrid.remove(drawingNum);
 	drawings.remove(drawingNum);
 	if (markedDrawing == drawingNum) markedDrawing = 0;
 	if (highlightedDrawing == drawingNum) highlightedDrawing = 0;
+	limitUndoMemory();
 	updateListData();
-	redraw();
 	return true;
 }
 
@@ -183,7 +535,6 @@ bool DrawingCollection::highlightDrawing(qint64 newHighlightedDrawing)
 {
 	if (highlightedDrawing == newHighlightedDrawing) return false;
 	highlightedDrawing = newHighlightedDrawing;
-	redraw();
 	return true;
 }
 
@@ -212,10 +563,12 @@ bool DrawingCollection::sendToZIndex(qint64 drawingNum, qint64 newZIndex)
 	const qint64 oldZIndex = drawing->zIndex;
 	if (oldZIndex == newZIndex) return false;
 
-	storeUndoPoint(drawingNum);
+	storeUndoPoint();
 	drawing->zIndex = newZIndex;
 	updateZIndexToDrawing();
-	redraw();
+	// the layers are split at the active drawing, they change completely if it is reordered
+	if (drawingNum == layers.activeDrawing) clearLayers();
+	invalidate(drawing->canvasRect(), true);
 	updateListData();
 	return true;
 }
@@ -253,6 +606,7 @@ void DrawingCollection::updateListData()
 		auto & drawing = drawings[drawNum];
 		entry.description = "[" + QString::number(drawNum) + "] " + drawing->config.name + " (" + QString::number(drawing->offset.x())
 							+ ", " + QString::number(drawing->offset.y()) + ")";
+		if (drawing->placeholder) entry.description += " - restoring";
 		entry.drawNum = drawNum;
 		drawing->listIndex = listData.size();
 		listData.push_back(entry);
@@ -267,6 +621,12 @@ int DrawingCollection::getDrawingNumByListIndex(int listIndex) const
 	return listData[listIndex].drawNum;
 }
 
+void DrawingCollection::updateDrawingGrid()
+{
+	drawingGrid.clear();
+	for (const auto & drawing : std::as_const(drawings)) drawingGrid.insert(drawing->num, drawing->canvasRect());
+}
+
 void DrawingCollection::updateZIndexToDrawing()
 {
 	zIndexToDrawing.clear();
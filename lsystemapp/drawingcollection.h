@@ -1,8 +1,11 @@
 #pragma once
 
 #include <drawing.h>
+#include <util/spatialgrid.h>
 
 #include <QAbstractListModel>
+#include <QRegion>
+#include <QSet>
 
 namespace lsystem::ui {
 
@@ -11,24 +14,49 @@ class DrawingCollection final : public QAbstractListModel
 	Q_OBJECT
 public:
 	void addOrReplaceDrawing(const QSharedPointer<Drawing> & newDrawing);
+	// Replaces all drawings and the history, e.g., by a restored session. The drawings keep their numbers,
+	// the z-order is the order of the list.
+	void setDrawings(const QList<QSharedPointer<Drawing>> & newDrawings, qint64 newMarkedDrawing);
+	// Replaces `oldDrawing` (e.g., a placeholder) on the canvas and in the history without an undo point,
+	// `newDrawing` takes over its number, offset and z-index. False if it is not on the canvas anymore.
+	bool replaceDrawing(const QSharedPointer<Drawing> & oldDrawing, const QSharedPointer<Drawing> & newDrawing);
 
-	void resize(const QSize & newSize);
 	void clearAll();
 
 	void redraw(bool keepContent = false);
+	// only `rect` (canvas coordinates) of the current drawing changed, e.g., by an animation step
+	void redrawRect(const QRect & rect);
 
-	void restoreLast();
+	bool undo();
+	bool redo();
+	bool canUndo() const { return !undoHistory.isEmpty(); }
+	bool canRedo() const { return !redoHistory.isEmpty(); }
+	void setUndoMemoryLimit(qint64 bytes);
 
 	qint64 getDrawingByPos(const QPoint & pos);
 	QPoint getDrawingOffset(qint64 drawingNum);
 	QPoint getDrawingSize(qint64 drawingNum);
-	QImage & getDrawingImage(qint64 drawingNum);
-	QImage getImage();
+	QRect getDrawingRect(qint64 drawingNum);
+	const TiledImage & getDrawingImage(qint64 drawingNum);
+	QSharedPointer<Drawing> getDrawing(qint64 drawingNum) const { return drawings.value(drawingNum); }
+	QList<QSharedPointer<Drawing>> getDrawingsInZOrder() const;
+	// The composite is stored as tiles in canvas coordinates, which are composited on demand.
+	// Only tiles around the viewport are kept.
+	void setViewport(const QRect & rect);
+	void paintCanvas(QPainter & painter, const QRect & rect);
+	QImage getImage(const QRect & rect);
+	// canvas area which was changed since the last call
+	QRegion takeDirtyRegion();
 	int getMarkedDrawingNum() const { return markedDrawing; }
 	int getHighlightedDrawingNum() const { return highlightedDrawing; }
 	Drawing * getCurrentDrawing();
 	bool setMarkedDrawing(qint64 newMarkedDrawing);
 	bool moveDrawing(qint64 drawingNum, const QPoint & newOffset, bool storeUndo = true);
+	// While dragging, moves only repaint the dragged drawing between the cached layers,
+	// the composite and the list are updated when the drag ends.
+	void beginDrag(qint64 drawingNum);
+	void endDrag();
+	bool isDragging() const { return dragDrawing != 0; }
 	bool deleteDrawing(qint64 drawingNum);
 	bool sendToFront(qint64 drawingNum);
 	bool sendToBack(qint64 drawingNum);
@@ -38,7 +66,7 @@ public:
 	int getDrawingNumByListIndex(int listIndex) const;
 
 	// called also externally, e.g., for move by drag
-	void storeUndoPoint(std::optional<int> numToCopy = std::nullopt);
+	void storeUndoPoint();
 
 	// ListModel:
 	int rowCount(const QModelIndex & parent = QModelIndex()) const override;
@@ -46,27 +74,71 @@ public:
 
 public:
 	QColor backColor = QColor(255, 255, 255);
+	// hit only painted pixels (with some tolerance) instead of the bounding rectangle
+	bool pixelAccurateHitTest = false;
 	bool dirty = false;
 
 signals:
 	void markingChanged();
 
 private:
+	// Undo/redo history of the canvas. The drawings are shared between the entries and the canvas,
+	// the history is limited by the memory of the drawings which are only referenced by the history.
+	struct UndoEntry final
+	{
+		struct DrawingState final
+		{
+			QSharedPointer<Drawing> drawing;
+			QPoint offset;
+			qint64 zIndex = 0;
+		};
+		QMap<qint64 /*drawNum*/, DrawingState> drawings;
+	};
+
+	UndoEntry currentUndoEntry() const;
+	void restoreUndoEntry(const UndoEntry & entry);
+	void limitUndoMemory();
+
 	bool sendToZIndex(qint64 drawingNum, qint64 newZIndex);
+	// Compositor: dirty tiles are recomposited from the cached layers below and above the active drawing.
+	void compositeTile(const QPoint & tileIndex);
+	void paintCanvasDragging(QPainter & painter, const QRect & rect);
+	const QImage & belowLayerTile(const QPoint & tileIndex);
+	const QImage * aboveLayerTile(const QPoint & tileIndex);
+	void invalidate(const QRect & rect, bool inLayers);
+	void invalidateAll();
+	void clearLayers();
 
 	// ListModel:
 	QString getRow(const QModelIndex & index) const;
 	void allDataChanged();
 	void updateListData();
 	void updateZIndexToDrawing();
+	void updateDrawingGrid();
 
 private:
-	QImage image;
+	TiledImage image;
+	QRect viewport;
+	QRegion dirtyRegion;
+
+	struct Layers final
+	{
+		qint64 activeDrawing = -1;
+		TiledImage below; // background and drawings below the active drawing
+		TiledImage above; // drawings above the active drawing, only allocated where they are
+		QSet<QPoint> aboveDone;
+	} layers;
+
+	qint64 dragDrawing = 0;
+	QRect dragStartRect;
 
 	QMap<qint64 /*drawNum*/, QSharedPointer<Drawing>> drawings;
 	QMap<qint64 /*zIndex*/, qint64 /*drawNum*/> zIndexToDrawing;
+	SpatialGrid drawingGrid;
 
-	QMap<qint64 /*drawNum*/, QSharedPointer<Drawing>> lastDrawings;
+	QList<UndoEntry> undoHistory;
+	QList<UndoEntry> redoHistory;
+	qint64 undoMemoryLimit = common::AppSettings::DefaultUndoMemoryMb * 1024 * 1024;
 
 	qint64 markedDrawing = 0;
 	qint64 highlightedDrawing = 0;
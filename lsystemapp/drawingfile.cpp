@@ -0,0 +1,152 @@
+#include "drawingfile.h"
+
+#include <jsonkeys.h>
+
+#include <QSaveFile>
+
+#include <type_traits>
+
+using namespace lsystem::common;
+using namespace lsystem::constants;
+
+namespace {
+
+constexpr quint32 Magic = 0x4c535944; // "LSYD"
+constexpr quint64 SectionAlignment = 4096;
+
+static_assert(std::is_trivially_copyable_v<LineSeg>, "segments are written as raw memory");
+
+struct FileHeader
+{
+	quint32 magic = Magic;
+	quint32 version = lsystem::DrawingFile::Version;
+	quint32 segSize = sizeof(LineSeg);
+	quint32 reserved = 0;
+	quint64 jsonOffset = 0;
+	quint64 jsonSize = 0;
+	quint64 segmentsOffset = 0;
+	quint64 segmentCount = 0;
+	quint64 segmentsLastIterOffset = 0;
+	quint64 segmentLastIterCount = 0;
+};
+
+quint64 align(quint64 pos) { return (pos + SectionAlignment - 1) / SectionAlignment * SectionAlignment; }
+
+bool writeSection(QSaveFile & file, quint64 offset, const char * data, qint64 size)
+{
+	// padding up to the section
+	const QByteArray padding(static_cast<qsizetype>(offset - file.pos()), '\0');
+	return file.write(padding) == padding.size() && file.write(data, size) == size;
+}
+
+LineSegs readSegments(const uchar * data, quint64 count)
+{
+	LineSegs rv;
+	rv.resize(static_cast<qsizetype>(count));
+	memcpy(static_cast<void *>(rv.data()), data, count * sizeof(LineSeg));
+	return rv;
+}
+
+} // namespace
+
+namespace lsystem {
+
+QString DrawingFile::save(const ui::Drawing & drawing, const QString & fileName)
+{
+	QJsonObject json;
+	json[JsonKeyName] = drawing.config.name;
+	json[JsonKeyConfigs] = drawing.config.toJson();
+	json[JsonKeyMeta] = drawing.meta().toJson();
+	QJsonArray colors;
+	for (const QColor & color : drawing.actionColors) colors << color.name(QColor::HexArgb);
+	json[JsonKeyActionColors] = colors;
+	const QByteArray jsonData = QJsonDocument(json).toJson(QJsonDocument::Compact);
+
+	FileHeader header;
+	header.jsonOffset = sizeof(FileHeader);
+	header.jsonSize = jsonData.size();
+	header.segmentCount = drawing.segmentCount();
+	header.segmentsOffset = align(header.jsonOffset + header.jsonSize);
+	header.segmentLastIterCount = drawing.segmentsLastIter.size();
+	header.segmentsLastIterOffset = align(header.segmentsOffset + header.segmentCount * sizeof(LineSeg));
+
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly)) return file.errorString();
+	if (!writeSection(file, 0, reinterpret_cast<const char *>(&header), sizeof(header))
+		|| !writeSection(file, header.jsonOffset, jsonData.constData(), jsonData.size())
+		|| !writeSection(file, header.segmentsOffset, nullptr, 0)) {
+		return file.errorString();
+	}
+	// out-of-core drawings are written range by range
+	bool ok = true;
+	drawing.forEachSegmentRange(false, 0, header.segmentCount, [&](const LineSeg * segs, qsizetype count, qint64) {
+		const qint64 size = count * static_cast<qint64>(sizeof(LineSeg));
+		ok = ok && file.write(reinterpret_cast<const char *>(segs), size) == size;
+	});
+	if (!ok
+		|| !writeSection(file,
+						 header.segmentsLastIterOffset,
+						 reinterpret_cast<const char *>(drawing.segmentsLastIter.constData()),
+						 header.segmentLastIterCount * sizeof(LineSeg))) {
+		return file.errorString();
+	}
+	if (!file.commit()) return file.errorString();
+	return QString();
+}
+
+DrawingFile::LoadResult DrawingFile::load(const QString & fileName)
+{
+	LoadResult rv;
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		rv.error = file.errorString();
+		return rv;
+	}
+
+	const quint64 fileSize = file.size();
+	const uchar * data = fileSize >= sizeof(FileHeader) ? file.map(0, fileSize) : nullptr;
+	if (!data) {
+		rv.error = "not a drawing file";
+		return rv;
+	}
+
+	FileHeader header;
+	memcpy(&header, data, sizeof(header));
+	const auto sectionValid = [fileSize](quint64 offset, quint64 size) { return offset <= fileSize && size <= fileSize - offset; };
+	if (header.magic != Magic || header.segSize != sizeof(LineSeg)) {
+		rv.error = "not a drawing file";
+	} else if (header.version != Version) {
+		rv.error = QString("unsupported version %1 of the drawing file").arg(header.version);
+	} else if (!sectionValid(header.jsonOffset, header.jsonSize)
+			   || header.segmentCount > fileSize / sizeof(LineSeg)
+			   || !sectionValid(header.segmentsOffset, header.segmentCount * sizeof(LineSeg))
+			   || header.segmentLastIterCount > fileSize / sizeof(LineSeg)
+			   || !sectionValid(header.segmentsLastIterOffset, header.segmentLastIterCount * sizeof(LineSeg))) {
+		rv.error = "the drawing file is truncated";
+	}
+	if (!rv.error.isEmpty()) return rv;
+
+	QJsonParseError err;
+	const QByteArray jsonData = QByteArray::fromRawData(reinterpret_cast<const char *>(data + header.jsonOffset), header.jsonSize);
+	const QJsonObject json = QJsonDocument::fromJson(jsonData, &err).object();
+	if (err.error != QJsonParseError::NoError) {
+		rv.error = "invalid meta data: " + err.errorString();
+		return rv;
+	}
+
+	rv.data = QSharedPointer<AllDrawData>::create();
+	rv.data->config = ConfigSet(json[JsonKeyConfigs].toObject());
+	rv.data->config.name = json[JsonKeyName].toString();
+	rv.data->config.valid = !rv.data->config.definitions.isEmpty();
+	rv.data->meta = MetaData(json[JsonKeyMeta].toObject());
+	rv.data->meta.execSegments = true;
+	rv.data->uiDrawData.resultOk = true;
+
+	for (const QJsonValue & color : json[JsonKeyActionColors].toArray()) rv.execResult.actionColors << QColor(color.toString());
+	rv.execResult.iterNum = rv.data->config.numIter;
+	rv.execResult.segments = readSegments(data + header.segmentsOffset, header.segmentCount);
+	rv.execResult.segmentsLastIter = readSegments(data + header.segmentsLastIterOffset, header.segmentLastIterCount);
+	return rv;
+}
+
+} // namespace lsystem
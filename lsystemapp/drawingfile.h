@@ -0,0 +1,30 @@
+#pragma once
+
+#include <drawing.h>
+
+namespace lsystem {
+
+// Binary file of a drawing: a header, the config, meta data and palette as JSON, and the segments as raw memory,
+// starting at a page boundary. For loading, the file is memory-mapped and the segments are taken over in one block,
+// i.e., the load time is bounded by reading the file.
+class DrawingFile final
+{
+public:
+	static const constexpr quint32 Version = 1;
+	static const constexpr char * Filter = "L-system drawing (*.lsd)";
+	static const constexpr char * Suffix = ".lsd";
+
+	struct LoadResult
+	{
+		QString error; // empty on success
+		common::ExecResult execResult{common::ExecResult::ExecResultKind::Ok};
+		QSharedPointer<common::AllDrawData> data;
+	};
+
+	// Only reads the segments and metadata of the drawing, so it may run in another thread.
+	static QString save(const ui::Drawing & drawing, const QString & fileName);
+	// The result can be passed to the segment drawer, the offset of the drawing is not set.
+	static LoadResult load(const QString & fileName);
+};
+
+} // namespace lsystem
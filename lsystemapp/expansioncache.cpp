@@ -0,0 +1,151 @@
+#include "expansioncache.h"
+
+#include <QDir>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <type_traits>
+
+using namespace lsystem::common;
+
+namespace {
+
+constexpr quint32 Magic = 0x4c535943; // "LSYC"
+
+static_assert(std::is_trivially_copyable_v<LineSeg>, "segments are written as raw memory");
+
+struct FileHeader
+{
+	quint32 magic = Magic;
+	quint32 version = lsystem::ExpansionCache::Version;
+	quint32 segSize = sizeof(LineSeg);
+	quint32 hasLastIter = 0;
+	quint64 key = 0;
+	quint64 segmentCount = 0;
+	quint64 segmentLastIterCount = 0;
+};
+
+// FNV-1a, stable across runs and platforms (unlike qHash, which is seeded)
+quint64 fnv1a(const QByteArray & data)
+{
+	quint64 rv = 14695981039346656037ull;
+	for (char c : data) {
+		rv ^= static_cast<quint8>(c);
+		rv *= 1099511628211ull;
+	}
+	return rv;
+}
+
+// The segments are copied once out of the mapping: the drawings keep them in a LineSegs (owning, implicitly shared),
+// which may outlive the file, e.g., if it is evicted. There is no intermediate read buffer, though.
+LineSegs readSegments(const uchar * data, quint64 count)
+{
+	LineSegs rv;
+	rv.resize(static_cast<qsizetype>(count));
+	memcpy(static_cast<void *>(rv.data()), data, count * sizeof(LineSeg));
+	return rv;
+}
+
+bool writeSegments(QSaveFile & file, const LineSegs & segs)
+{
+	const qint64 size = static_cast<qint64>(segs.size() * sizeof(LineSeg));
+	return file.write(reinterpret_cast<const char *>(segs.constData()), size) == size;
+}
+
+} // namespace
+
+namespace lsystem {
+
+ExpansionCache::ExpansionCache(const QString & directory, qint64 maxSize)
+	: directory(directory)
+	, maxSize(maxSize)
+{
+	QDir().mkpath(directory);
+}
+
+quint64 ExpansionCache::fingerprint(const ConfigSet & config)
+{
+	// the name and the stack size do not change the expansion
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_6_0);
+	stream << Version;
+	for (const Definition & def : config.definitions) {
+		stream << static_cast<qint8>(def.literal) << def.command << def.color.rgba() << def.paint << def.move;
+	}
+	stream << config.turn.left << config.turn.right << config.scaling << config.startAngle << config.numIter << config.stepSize;
+	return fnv1a(data);
+}
+
+std::optional<ExpansionCache::Entry> ExpansionCache::load(quint64 key) const
+{
+	QFile file(filePath(key));
+	if (!file.open(QIODevice::ReadWrite)) return {};
+
+	const qint64 fileSize = file.size();
+	if (fileSize < static_cast<qint64>(sizeof(FileHeader))) return {};
+	const uchar * data = file.map(0, fileSize);
+	if (!data) return {};
+
+	FileHeader header;
+	memcpy(&header, data, sizeof(header));
+	const quint64 segmentsSize = (header.segmentCount + header.segmentLastIterCount) * sizeof(LineSeg);
+	if (header.magic != Magic || header.version != Version || header.segSize != sizeof(LineSeg) || header.key != key
+		|| segmentsSize != static_cast<quint64>(fileSize) - sizeof(header)) {
+		return {};
+	}
+
+	Entry rv;
+	rv.segments = readSegments(data + sizeof(header), header.segmentCount);
+	if (header.hasLastIter) {
+		rv.segmentsLastIter = readSegments(data + sizeof(header) + header.segmentCount * sizeof(LineSeg), header.segmentLastIterCount);
+	}
+	file.unmap(const_cast<uchar *>(data));
+
+	// for the eviction
+	file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+	return rv;
+}
+
+bool ExpansionCache::store(quint64 key, const Entry & entry)
+{
+	FileHeader header;
+	header.key = key;
+	header.hasLastIter = entry.segmentsLastIter.has_value();
+	header.segmentCount = entry.segments.size();
+	header.segmentLastIterCount = entry.segmentsLastIter ? entry.segmentsLastIter->size() : 0;
+	if ((header.segmentCount + header.segmentLastIterCount) * sizeof(LineSeg) > static_cast<quint64>(maxSize)) return false;
+
+	QSaveFile file(filePath(key));
+	if (!file.open(QIODevice::WriteOnly)) return false;
+	if (file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header)) return false;
+	if (!writeSegments(file, entry.segments)) return false;
+	if (entry.segmentsLastIter && !writeSegments(file, *entry.segmentsLastIter)) return false;
+	if (!file.commit()) return false;
+
+	evict();
+	return true;
+}
+
+QString ExpansionCache::filePath(quint64 key) const
+{
+	return QDir(directory).filePath(QString("%1.segs").arg(key, 16, 16, QChar('0')));
+}
+
+void ExpansionCache::evict()
+{
+	QFileInfoList files = QDir(directory).entryInfoList({"*.segs"}, QDir::Files);
+	qint64 totalSize = 0;
+	for (const QFileInfo & info : std::as_const(files)) totalSize += info.size();
+	if (totalSize <= maxSize) return;
+
+	std::sort(files.begin(), files.end(), [](const QFileInfo & lhs, const QFileInfo & rhs) {
+		return lhs.lastModified() < rhs.lastModified();
+	});
+	for (const QFileInfo & info : std::as_const(files)) {
+		if (totalSize <= maxSize) break;
+		if (QFile::remove(info.filePath())) totalSize -= info.size();
+	}
+}
+
+} // namespace lsystem
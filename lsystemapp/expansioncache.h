@@ -0,0 +1,43 @@
+#pragma once
+
+#include <common.h>
+
+#include <optional>
+
+namespace lsystem {
+
+// Disk cache of expanded segments, content-addressed by a fingerprint of the parts of the config which determine the
+// expansion. Every entry is one file, which is memory-mapped for loading. The least recently used entries are removed
+// if the cache exceeds its size. Entries are written atomically, `store` may run in a background thread.
+class ExpansionCache final
+{
+public:
+	// part of the fingerprint and the file header, increase if the segments or the file layout change
+	static const constexpr quint32 Version = 1;
+	static const constexpr qint64 DefaultMaxSize = 512ll << 20;
+	// smaller expansions are faster calculated than loaded
+	static const constexpr qsizetype MinSegments = 1 << 16;
+
+	struct Entry
+	{
+		common::LineSegs segments;
+		std::optional<common::LineSegs> segmentsLastIter; // only if the last iteration was requested
+	};
+
+	explicit ExpansionCache(const QString & directory, qint64 maxSize = DefaultMaxSize);
+
+	static quint64 fingerprint(const common::ConfigSet & config);
+
+	std::optional<Entry> load(quint64 key) const;
+	bool store(quint64 key, const Entry & entry);
+
+private:
+	QString filePath(quint64 key) const;
+	void evict();
+
+private:
+	const QString directory;
+	const qint64 maxSize;
+};
+
+} // namespace lsystem
@@ -18,6 +18,39 @@ const constexpr char * JsonKeyStartAngle = "startAngle";
 const constexpr char * JsonKeyNumIter = "numIter";
 const constexpr char * JsonKeyStepSize = "stepSize";
 
+const constexpr char * JsonKeyName = "name";
+const constexpr char * JsonKeyMeta = "meta";
+const constexpr char * JsonKeyActionColors = "actionColors";
+
+const constexpr char * JsonKeyShowLastIter = "showLastIter";
+const constexpr char * JsonKeyLastIterOpacity = "lastIterOpacity";
+const constexpr char * JsonKeyThickness = "thickness";
+const constexpr char * JsonKeyOpacity = "opacity";
+const constexpr char * JsonKeyAntiAliasing = "antiAliasing";
+const constexpr char * JsonKeyGradientStart = "gradientStart";
+const constexpr char * JsonKeyGradientEnd = "gradientEnd";
+const constexpr char * JsonKeyLevelOfDetail = "levelOfDetail";
+const constexpr char * JsonKeyDensityMode = "densityMode";
+const constexpr char * JsonKeyOutOfCore = "outOfCore";
+
+const constexpr char * JsonKeyVersion = "version";
+const constexpr char * JsonKeyBackColor = "backColor";
+const constexpr char * JsonKeyMarked = "marked";
+const constexpr char * JsonKeyDrawings = "drawings";
+const constexpr char * JsonKeyNum = "num";
+const constexpr char * JsonKeyStackSize = "stackSize";
+const constexpr char * JsonKeyOffset = "offset";
+const constexpr char * JsonKeyBounds = "bounds";
+
 const constexpr char * JsonKeySettingsMaxStackSize = "maxStackSize";
+const constexpr char * JsonKeySettingsUndoMemoryMb = "undoMemoryMb";
+const constexpr char * JsonKeySettingsPixelAccurateHitTest = "pixelAccurateHitTest";
+
+const constexpr char * JsonKeyJournalOp = "op";
+const constexpr char * JsonKeyJournalName = "name";
+const constexpr char * JsonKeyJournalConfig = "config";
+const constexpr char * JsonJournalOpStore = "store";
+const constexpr char * JsonJournalOpRemove = "remove";
+const constexpr char * JsonJournalOpSettings = "settings";
 
 } // namespace lsystem::constants
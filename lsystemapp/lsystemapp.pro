@@ -1,4 +1,4 @@
-QT += core widgets gui quick quickwidgets quickcontrols2 qml
+QT += core widgets gui quick quickwidgets quickcontrols2 qml concurrent
 
 CONFIG += c++20
 
@@ -6,6 +6,7 @@ SOURCES += \
 	aboutdialog.cpp \
 	angleevaluator.cpp \
 	angleformuladialog.cpp \
+	animationexporter.cpp \
 	common.cpp \
 	configfilestore.cpp \
 	configlist.cpp \
@@ -13,27 +14,39 @@ SOURCES += \
 	drawarea.cpp \
 	drawing.cpp \
 	drawingcollection.cpp \
+	drawingfile.cpp \
+	expansioncache.cpp \
 	lsystemui.cpp \
 	main.cpp \
+	posterexporter.cpp \
 	segmentanimator.cpp \
 	segmentdrawer.cpp \
+	sessionfile.cpp \
 	settingsdialog.cpp \
 	simulator.cpp \
+	symbolexporter.cpp \
 	symbolsdialog.cpp \
+	util/apngwriter.cpp \
 	util/clickablelabel.cpp \
 	util/focusablelineedit.cpp \
 	util/gradientpreview.cpp \
 	util/playercontrol.cpp \
+	util/pngstreamwriter.cpp \
 	util/qpointenhance.cpp \
 	util/quickangle.cpp \
 	util/quickbase.cpp \
 	util/quicklinear.cpp \
-	util/tableitemdelegate.cpp
+	util/spatialgrid.cpp \
+	util/tableitemdelegate.cpp \
+	util/tiledimage.cpp \
+	vectorexporter.cpp \
+	viewportrenderer.cpp
 
 HEADERS += \
 	aboutdialog.h \
 	angleevaluator.h \
 	angleformuladialog.h \
+	animationexporter.h \
 	common.h \
 	configfilestore.h \
 	configlist.h \
@@ -41,24 +54,36 @@ HEADERS += \
 	drawarea.h \
 	drawing.h \
 	drawingcollection.h \
+	drawingfile.h \
+	expansioncache.h \
 	jsonkeys.h \
 	lsystemui.h \
+	posterexporter.h \
 	segmentanimator.h \
 	segmentdrawer.h \
+	sessionfile.h \
 	settingsdialog.h \
 	simulator.h \
+	symbolexporter.h \
 	symbolsdialog.h \
+	util/apngwriter.h \
 	util/clickablelabel.h \
 	util/focusablelineedit.h \
 	util/gradientpreview.h \
+	util/intmath.h \
 	util/playercontrol.h \
+	util/pngstreamwriter.h \
 	util/qpointenhance.h \
 	util/quickangle.h \
 	util/quickbase.h \
 	util/quicklinear.h \
+	util/spatialgrid.h \
 	util/tableitemdelegate.h \
+	util/tiledimage.h \
 	util/valuerestriction.h \
-	version.h
+	vectorexporter.h \
+	version.h \
+	viewportrenderer.h
 
 FORMS += \
 	aboutdialog.ui \
@@ -80,6 +105,10 @@ qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
 !isEmpty(target.path): INSTALLS += target
 
+# zlib for the streaming PNG encoder and the symbol export, Qt for Windows comes with its own (MinGW has none)
+win32: QT += zlib-private
+else: LIBS += -lz
+
 RESOURCES += \
 	data/config.qrc \
 	util/util.qrc
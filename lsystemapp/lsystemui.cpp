@@ -2,26 +2,38 @@
 #include "ui_lsystemui.h"
 
 #include <aboutdialog.h>
+#include <animationexporter.h>
 #include <angleformuladialog.h>
 #include <configfilestore.h>
 #include <configlist.h>
 #include <definitionmodel.h>
 #include <drawarea.h>
+#include <drawingfile.h>
+#include <expansioncache.h>
+#include <posterexporter.h>
 #include <segmentanimator.h>
 #include <segmentdrawer.h>
+#include <sessionfile.h>
 #include <settingsdialog.h>
 #include <simulator.h>
 #include <util/containerutils.h>
 #include <util/print.h>
 #include <util/tableitemdelegate.h>
+#include <vectorexporter.h>
 #include <version.h>
 
 #include <QClipboard>
+#include <QCloseEvent>
 #include <QColorDialog>
 #include <QDebug>
+#include <QFileDialog>
 #include <QGuiApplication>
 #include <QInputDialog>
 #include <QMessageBox>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+#include <algorithm>
 
 using namespace lsystem;
 using namespace lsystem::common;
@@ -44,6 +56,50 @@ const int StatusIntervalMs = 8000;
 // After this interval we execute pending operations, if no new input from the user came in.
 const int ExecPendingIntervalMs = 100;
 
+// captures the current position of the drawings for an export in the background
+QList<VectorExportItem> toExportItems(const QList<QSharedPointer<Drawing>> & drawings)
+{
+	QList<VectorExportItem> rv;
+	for (const QSharedPointer<Drawing> & drawing : drawings) {
+		VectorExportItem item{.drawing = drawing, .offset = drawing->offset, .canvasRect = drawing->canvasRect()};
+		if (drawing->mainMeta.densityMode) item.densityImage = drawing->image;
+		rv << item;
+	}
+	return rv;
+}
+
+// Executes the config of a drawing synchronously, in a worker thread with an own simulator. Null if the config is invalid.
+QSharedPointer<Drawing> executeDrawing(const QSharedPointer<AllDrawData> & data,
+									   int maxStackSize,
+									   const QSharedPointer<ExpansionCache> & cache)
+{
+	Simulator simulator;
+	simulator.setMaxStackSize(maxStackSize);
+	simulator.setExpansionCache(cache);
+	QSharedPointer<Drawing> rv;
+	const auto onSegments = [&rv](const ExecResult & result, const QSharedPointer<AllDrawData> & resData) {
+		if (result.resultKind != ExecResult::ExecResultKind::InvalidConfig) rv = QSharedPointer<Drawing>::create(result, resData);
+	};
+	QObject::connect(&simulator, &Simulator::segmentsReceived, onSegments);
+	simulator.exec(data);
+	return rv;
+}
+
+struct LoadedDrawing final
+{
+	QString error; // empty on success
+	QSharedPointer<Drawing> drawing;
+};
+
+// Loads a drawing file and draws it at the given position, such that it may run in a worker thread.
+LoadedDrawing loadDrawingFile(const QString & fileName, const QPoint & canvasPos)
+{
+	const DrawingFile::LoadResult result = DrawingFile::load(fileName);
+	if (!result.error.isEmpty()) return LoadedDrawing{.error = result.error};
+	result.data->uiDrawData.offset = canvasPos;
+	return LoadedDrawing{.drawing = QSharedPointer<Drawing>::create(result.execResult, result.data)};
+}
+
 QString generateBgColorStyle(const QColor & col)
 {
 	return QString("background-color: rgb(") + QString::number(col.red()) + "," + QString::number(col.green()) + ","
@@ -70,16 +126,23 @@ LSystemUi::LSystemUi(QWidget * parent)
 	setupStatusAndTimers();
 	setupInteractiveControls();
 	setupDrawAreaAndLayers();
+
+	// after the window is laid out, for the visible area
+	QTimer::singleShot(0, this, &LSystemUi::restoreSession);
 }
 
 void LSystemUi::setupServices()
 {
 	// setup the background service for generating/animating the fractals
+	const QString cacheLocation = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+	expansionCache = QSharedPointer<ExpansionCache>::create(cacheLocation + "/expansions");
+	SegmentSpill::removeStaleFiles();
 	simulator.reset(new Simulator());
+	simulator->setExpansionCache(expansionCache);
 	simulator->moveToThread(&simulatorThread);
 	connect(this, &LSystemUi::simulatorExec, simulator.get(), &Simulator::exec);
 	connect(simulator.get(), &Simulator::segmentsReceived, this, &LSystemUi::processSimulatorSegments);
-	connect(simulator.get(), &Simulator::actionStrReceived, this, &LSystemUi::processActionStr);
+	connect(simulator.get(), &Simulator::symbolsReceived, this, &LSystemUi::processSymbols);
 	connect(simulator.get(), &Simulator::errorReceived, this, &LSystemUi::showErrorInUi);
 	simulatorThread.start();
 
@@ -95,10 +158,51 @@ void LSystemUi::setupServices()
 	// clang-format off
 	connect(this, &LSystemUi::startAnimateCurrentDrawing, segAnimator.get(), &SegmentAnimator::startAnimateCurrentDrawing);
 	connect(this, &LSystemUi::setAnimateLatency,          segAnimator.get(), &SegmentAnimator::setAnimateLatency);
+	connect(this, &LSystemUi::setAnimateDuration,         segAnimator.get(), &SegmentAnimator::setAnimateDuration);
 	connect(this, &LSystemUi::stopAnimate,                segAnimator.get(), &SegmentAnimator::stopAnimate);
 	connect(this, &LSystemUi::goToAnimationStep,          segAnimator.get(), &SegmentAnimator::goToAnimationStep);
 	// clang-format on
 	connect(segAnimator.get(), &SegmentAnimator::newAnimationStep, this, &LSystemUi::newAnimationStep);
+
+	// animation export, renders and encodes in worker threads
+	animExporter.reset(new AnimationExporter());
+	connect(animExporter.get(), &AnimationExporter::progress, this, [this](int frame, int frameCount) {
+		showMessage(QString("Exporting animation: frame %1 of %2").arg(frame).arg(frameCount), MsgType::Info);
+	});
+	connect(animExporter.get(), &AnimationExporter::finished, this, [this](const QString & errorString) {
+		if (errorString.isEmpty()) {
+			showMessage("Animation exported", MsgType::Info);
+		} else {
+			showErrorInUi("Animation export failed: " + errorString);
+		}
+	});
+
+	posterExporter.reset(new PosterExporter());
+	connect(posterExporter.get(), &PosterExporter::progress, this, [this](int band, int bandCount) {
+		showMessage(QString("Exporting PNG: %1%").arg(band * 100 / bandCount), MsgType::Info);
+	});
+	connect(posterExporter.get(), &PosterExporter::finished, this, [this](const QString & errorString) {
+		if (errorString.isEmpty()) {
+			showMessage("PNG exported", MsgType::Info);
+		} else {
+			showErrorInUi("PNG export failed: " + errorString);
+		}
+	});
+
+	vectorExporter.reset(new VectorExporter());
+	connect(vectorExporter.get(), &VectorExporter::finished, this, [this](const QString & errorString, qint64 bytes, qint64 elapsedMs) {
+		if (!errorString.isEmpty()) {
+			showErrorInUi("Vector export failed: " + errorString);
+			return;
+		}
+		const double megabytes = bytes / (1024. * 1024.);
+		const double seconds = qMax<qint64>(elapsedMs, 1) / 1000.;
+		showMessage(QString("Exported %1 MB in %2 s (%3 MB/s)")
+						.arg(megabytes, 0, 'f', 1)
+						.arg(seconds, 0, 'f', 1)
+						.arg(megabytes / seconds, 0, 'f', 1),
+					MsgType::Info);
+	});
 }
 
 void LSystemUi::setupConfigList()
@@ -171,6 +275,9 @@ void LSystemUi::setupHelperControls()
 	connect(ui->chkShowLastIter, &QCheckBox::checkStateChanged, this, &LSystemUi::onChkShowLastIterStateChanged);
 	connect(ui->chkAntiAliasing, &QCheckBox::checkStateChanged, this, &LSystemUi::configLiveEdit);
 	connect(ui->chkAutoMax, &QCheckBox::checkStateChanged, this, &LSystemUi::configLiveEdit);
+	connect(ui->chkLevelOfDetail, &QCheckBox::checkStateChanged, this, &LSystemUi::configLiveEdit);
+	connect(ui->chkDensity, &QCheckBox::checkStateChanged, this, &LSystemUi::configLiveEdit);
+	connect(ui->chkOutOfCore, &QCheckBox::checkStateChanged, this, &LSystemUi::configLiveEdit);
 
 	// Defaults
 	connect(ui->cmdResetDefaultOptions, &QPushButton::clicked, this, &LSystemUi::onCmdResetDefaultOptionsClicked);
@@ -237,6 +344,7 @@ void LSystemUi::setupInteractiveControls()
 	}
 
 	connect(ui->txtLatency, &FocusableLineEdit::textChanged, this, &LSystemUi::latencyChanged);
+	connect(ui->chkTotalDuration, &QCheckBox::checkStateChanged, this, &LSystemUi::latencyChanged);
 }
 
 bool LSystemUi::eventFilter(QObject * obj, QEvent * event)
@@ -257,6 +365,11 @@ void LSystemUi::setupDrawAreaAndLayers()
 	connect(drawArea, &DrawArea::mouseClick, this, &LSystemUi::drawAreaClick);
 	connect(drawArea, &DrawArea::highlightChanged, this, &LSystemUi::highlightChanged);
 	connect(drawArea, &DrawArea::showSymbols, this, &LSystemUi::showSymbols);
+	connect(drawArea, &DrawArea::exportAnimation, this, &LSystemUi::exportAnimation);
+	connect(drawArea, &DrawArea::exportVector, this, &LSystemUi::exportVector);
+	connect(drawArea, &DrawArea::exportPoster, this, &LSystemUi::exportPoster);
+	connect(drawArea, &DrawArea::saveDrawing, this, &LSystemUi::saveDrawing);
+	connect(drawArea, &DrawArea::loadDrawing, this, &LSystemUi::loadDrawing);
 
 	// Label for move/maximize commands
 	lblDrawActions.reset(new ClickableLabel(drawArea));
@@ -268,6 +381,10 @@ void LSystemUi::setupDrawAreaAndLayers()
 
 	DrawingCollection * drawingCollection = &drawArea->getDrawingCollection();
 	connect(drawingCollection, &DrawingCollection::markingChanged, this, &LSystemUi::markingChanged);
+	connect(configFileStore.get(), &ConfigFileStore::newUndoMemoryLimit, drawArea, &DrawArea::setUndoMemoryLimit);
+	drawArea->setUndoMemoryLimit(configFileStore->getSettings().undoMemoryMb);
+	connect(configFileStore.get(), &ConfigFileStore::newPixelAccurateHitTest, drawArea, &DrawArea::setPixelAccurateHitTest);
+	drawArea->setPixelAccurateHitTest(configFileStore->getSettings().pixelAccurateHitTest);
 	ui->lstLayers->setModel(drawingCollection);
 
 	// to get the context menu shortcurts working
@@ -291,6 +408,9 @@ void LSystemUi::onCmdDeleteLayerClicked()
 
 LSystemUi::~LSystemUi()
 {
+	// drawings which are not restored yet are dropped
+	restore.pool.clear();
+	restore.pool.waitForDone();
 	quitAndWait({&simulatorThread, &segDrawerThread});
 	delete ui;
 }
@@ -376,6 +496,9 @@ void LSystemUi::getAdditionalOptionsForSegmentsMeta(MetaData & execMeta, bool no
 	if (ok) execMeta.thickness = thickness;
 
 	execMeta.antiAliasing = ui->chkAntiAliasing->isChecked();
+	execMeta.levelOfDetail = ui->chkLevelOfDetail->isChecked();
+	execMeta.densityMode = ui->chkDensity->isChecked();
+	execMeta.outOfCore = ui->chkOutOfCore->isChecked();
 
 	if (!noMaximize) execMeta.maximize = ui->chkAutoMax->isChecked();
 }
@@ -403,6 +526,182 @@ void LSystemUi::showSymbols()
 	}
 }
 
+void LSystemUi::exportAnimation(const QSharedPointer<lsystem::ui::Drawing> & drawing, const QColor & backColor)
+{
+	if (animExporter->isActive()) {
+		showWarningInUi("An animation export is already running");
+		return;
+	}
+
+	const QString apngFilter = "Animated PNG (*.png)";
+	const QString sequenceFilter = "PNG sequence (*.png)";
+	QString selectedFilter = apngFilter;
+	const QString fileName
+		= QFileDialog::getSaveFileName(this, "Export animation", QString(), apngFilter + ";;" + sequenceFilter, &selectedFilter);
+	if (fileName.isEmpty()) return;
+
+	bool ok;
+	const int segmentsCount = static_cast<int>(drawing->segments.size());
+	const int frameCount
+		= QInputDialog::getInt(this, "Export animation", "Number of frames:", qMin(100, segmentsCount), 1, qMax(1, segmentsCount), 1, &ok);
+	if (!ok) return;
+	const QPoint drawingSize = drawing->size() + QPoint(1, 1);
+	const int width = QInputDialog::getInt(this, "Export animation", "Width in pixels:", drawingSize.x(), 16, 16384, 1, &ok);
+	if (!ok) return;
+
+	AnimationExportSettings settings;
+	settings.fileName = fileName;
+	if (selectedFilter == sequenceFilter) settings.format = AnimationExportSettings::Format::PngSequence;
+	settings.frameCount = frameCount;
+	settings.resolution = QSize(width, qMax(1, qRound(static_cast<double>(width) * drawingSize.y() / drawingSize.x())));
+	settings.backColor = backColor;
+	animExporter->start(drawing, settings);
+}
+
+void LSystemUi::exportVector(const QList<QSharedPointer<lsystem::ui::Drawing>> & drawings, const QColor & backColor)
+{
+	if (vectorExporter->isActive()) {
+		showWarningInUi("A vector export is already running");
+		return;
+	}
+
+	const QString svgFilter = "SVG (*.svg)";
+	const QString pdfFilter = "PDF (*.pdf)";
+	QString selectedFilter = svgFilter;
+	QString fileName = QFileDialog::getSaveFileName(this, "Export as SVG/PDF", QString(), svgFilter + ";;" + pdfFilter, &selectedFilter);
+	if (fileName.isEmpty()) return;
+	const QString suffix = selectedFilter == pdfFilter ? ".pdf" : ".svg";
+	if (!fileName.endsWith(".svg", Qt::CaseInsensitive) && !fileName.endsWith(".pdf", Qt::CaseInsensitive)) fileName += suffix;
+
+	vectorExporter->start(toExportItems(drawings), backColor, fileName);
+}
+
+void LSystemUi::exportPoster(const QList<QSharedPointer<lsystem::ui::Drawing>> & drawings, const QColor & backColor)
+{
+	if (posterExporter->isActive()) {
+		showWarningInUi("A PNG export is already running");
+		return;
+	}
+
+	const QList<VectorExportItem> items = toExportItems(drawings);
+	bool ok;
+	const double scale = QInputDialog::getDouble(this, "Export as large PNG", "Scale factor:", 4, 0.01, 1000, 2, &ok);
+	if (!ok) return;
+	const QSize size = PosterExporter::outputSize(items, scale);
+	if (size.width() > PosterExporter::MaxSize || size.height() > PosterExporter::MaxSize) {
+		showWarningInUi(QString("The image would be %1x%2 pixels, at most %3 are possible")
+							.arg(size.width())
+							.arg(size.height())
+							.arg(PosterExporter::MaxSize));
+		return;
+	}
+
+	const QString title = QString("Export as PNG (%1x%2)").arg(size.width()).arg(size.height());
+	QString fileName = QFileDialog::getSaveFileName(this, title, QString(), "PNG (*.png)");
+	if (fileName.isEmpty()) return;
+	if (!fileName.endsWith(".png", Qt::CaseInsensitive)) fileName += ".png";
+	posterExporter->start(items, backColor, scale, fileName);
+}
+
+void LSystemUi::saveDrawing(const QSharedPointer<lsystem::ui::Drawing> & drawing)
+{
+	QString fileName = QFileDialog::getSaveFileName(this, "Save drawing", QString(), DrawingFile::Filter);
+	if (fileName.isEmpty()) return;
+	if (!fileName.endsWith(DrawingFile::Suffix, Qt::CaseInsensitive)) fileName += DrawingFile::Suffix;
+
+	// the segments are written in the background, they are not changed after the construction of the drawing
+	auto * watcher = new QFutureWatcher<QString>(this);
+	connect(watcher, &QFutureWatcher<QString>::finished, this, [this, watcher]() {
+		const QString errorString = watcher->result();
+		if (errorString.isEmpty()) {
+			showMessage("Drawing saved", MsgType::Info);
+		} else {
+			showErrorInUi("Saving the drawing failed: " + errorString);
+		}
+		watcher->deleteLater();
+	});
+	watcher->setFuture(QtConcurrent::run([drawing, fileName]() { return DrawingFile::save(*drawing, fileName); }));
+}
+
+void LSystemUi::loadDrawing(const QPoint & canvasPos)
+{
+	const QString fileName = QFileDialog::getOpenFileName(this, "Load drawing", QString(), DrawingFile::Filter);
+	if (fileName.isEmpty()) return;
+
+	// not drawn by the segment drawer, the executions of the simulator are independent of loaded drawings
+	auto * watcher = new QFutureWatcher<LoadedDrawing>(this);
+	connect(watcher, &QFutureWatcher<LoadedDrawing>::finished, this, [this, watcher]() {
+		const LoadedDrawing result = watcher->result();
+		watcher->deleteLater();
+		if (!result.error.isEmpty()) {
+			showErrorInUi("Loading the drawing failed: " + result.error);
+			return;
+		}
+		drawArea->draw(result.drawing);
+		const DrawingSummary summary = result.drawing->toDrawingSummary();
+		ui->playerControl->setMaxValueAndValue(summary.segmentsCount, summary.animStep);
+		showMessage("Drawing loaded", MsgType::Info);
+	});
+	watcher->setFuture(QtConcurrent::run([fileName, canvasPos]() { return loadDrawingFile(fileName, canvasPos); }));
+}
+
+void LSystemUi::closeEvent(QCloseEvent * event)
+{
+	const SessionFile::Session session = SessionFile::fromDrawings(drawArea->getDrawingCollection());
+	const QString errorString = SessionFile::save(session, SessionFile::DefaultFileName);
+	if (!errorString.isEmpty()) QMessageBox::warning(this, "Save session", "Saving the session failed: " + errorString);
+	QMainWindow::closeEvent(event);
+}
+
+void LSystemUi::restoreSession()
+{
+	const SessionFile::LoadResult result = SessionFile::load(SessionFile::DefaultFileName);
+	if (!result.error.isEmpty()) {
+		showErrorInUi("Restoring the session failed: " + result.error);
+		return;
+	}
+	const SessionFile::Session & session = result.session;
+	if (session.entries.isEmpty()) return;
+
+	QList<QSharedPointer<Drawing>> placeholders;
+	for (const SessionFile::Entry & entry : session.entries) placeholders << Drawing::createPlaceholder(entry.data, entry.bounds);
+	if (session.backColor.isValid()) drawArea->getDrawingCollection().backColor = session.backColor;
+	drawArea->setDrawings(placeholders, session.markedDrawing);
+
+	// visible drawings first, from the top
+	const QRect visibleRect = drawArea->visibleCanvasRect();
+	QList<int> order;
+	for (int i = placeholders.size() - 1; i >= 0; --i) order << i;
+	std::stable_partition(order.begin(), order.end(), [&](int i) { return placeholders[i]->canvasRect().intersects(visibleRect); });
+
+	// the simulator of the UI stays available, the restore runs in an own pool and reuses the cached expansions
+	const int maxStackSize = configFileStore->getSettings().maxStackSize;
+	restore.pending += order.size();
+	for (int i : std::as_const(order)) {
+		const QSharedPointer<Drawing> placeholder = placeholders[i];
+		const QSharedPointer<AllDrawData> data = session.entries[i].data;
+		auto * watcher = new QFutureWatcher<QSharedPointer<Drawing>>(this);
+		connect(watcher, &QFutureWatcher<QSharedPointer<Drawing>>::finished, this, [this, watcher, placeholder]() {
+			const QSharedPointer<Drawing> drawing = watcher->result();
+			watcher->deleteLater();
+			if (drawing) {
+				drawArea->replaceDrawing(placeholder, drawing);
+			} else {
+				++restore.failed;
+			}
+			if (--restore.pending > 0) return;
+			if (restore.failed > 0) {
+				showWarningInUi(QString("Session restored, %1 drawings could not be executed").arg(restore.failed));
+			} else {
+				showMessage("Session restored", MsgType::Info);
+			}
+			restore.failed = 0;
+		});
+		const auto execute = [data, maxStackSize, cache = expansionCache]() { return executeDrawing(data, maxStackSize, cache); };
+		watcher->setFuture(QtConcurrent::run(&restore.pool, execute));
+	}
+}
+
 bool LSystemUi::symbolsVisible() const { return symbolsDialog && symbolsDialog->isVisible(); }
 
 
@@ -412,9 +711,10 @@ LSystemUi::DrawPlacement LSystemUi::getDrawPlacement(const lsystem::ui::DrawingF
 
 	const auto & drawGeom = drawArea->geometry();
 	rv.drawingSize = drawingFrameResult.botRight - drawingFrameResult.topLeft;
-	rv.areaTopLeft = DrawPlacement::outerDist;
 	rv.areaWidthHeight = QPoint(drawGeom.width(), drawArea->height());
-	rv.areaBotRight = rv.areaWidthHeight - DrawPlacement::outerDist;
+	// visible part of the canvas, which may be zoomed or panned
+	rv.areaTopLeft = drawArea->mapToCanvas(DrawPlacement::outerDist);
+	rv.areaBotRight = drawArea->mapToCanvas(rv.areaWidthHeight - DrawPlacement::outerDist);
 	rv.areaSize = rv.areaBotRight - rv.areaTopLeft;
 
 	const double wdtFct = static_cast<double>(rv.areaSize.x()) / rv.drawingSize.x();
@@ -610,7 +910,7 @@ void LSystemUi::highlightChanged(std::optional<DrawingSummary> drawResult)
 
 	// first guess label pos
 	const auto & drawing = drawResult.value();
-	QPoint labelPos = drawing.topLeft + DrawPlacement::outerDist;
+	QPoint labelPos = drawArea->mapFromCanvas(drawing.topLeft) + DrawPlacement::outerDist;
 
 	// Always display maxize button
 	const bool showMax = true;
@@ -696,11 +996,11 @@ void LSystemUi::processSimulatorSegments(const common::ExecResult & execResult,
 	emit startDraw(execResult, data); // drawDone also calls endInvokeExec
 }
 
-void LSystemUi::processActionStr(const QString & actionStr)
+void LSystemUi::processSymbols(const SymbolSourcePtr & symbols)
 {
 	endInvokeExec(ExecKind::ActionStr);
 
-	if (symbolsVisible()) symbolsDialog->setContent(actionStr);
+	if (symbolsVisible()) symbolsDialog->setContent(symbols);
 }
 
 void LSystemUi::drawDone(const QSharedPointer<Drawing> & drawing, const QSharedPointer<AllDrawData> & data)
@@ -712,11 +1012,14 @@ void LSystemUi::drawDone(const QSharedPointer<Drawing> & drawing, const QSharedP
 
 	drawArea->draw(drawing);
 
-	if (!uiData.causedByLink) ui->playerControl->setMaxValueAndValue(drawing->segments.size(), drawing->segments.size());
+	if (!uiData.causedByLink) {
+		const DrawingSummary summary = drawing->toDrawingSummary();
+		ui->playerControl->setMaxValueAndValue(summary.segmentsCount, summary.animStep);
+	}
 
 	if (uiData.resultOk) {
 		const QString msgPainted = printStr("Painted %1 segments, size is %2 px, <a href=\"%3\">show symbols</a>",
-											drawing->segments.size(),
+											drawing->segmentCount(),
 											drawing->size(),
 											Links::ShowSymbols);
 
@@ -900,7 +1203,11 @@ void LSystemUi::latencyChanged()
 		showVarError("latency", "must be a positive number");
 	}
 	std::chrono::milliseconds latencyMs{qRound(latency * 1000)};
-	emit setAnimateLatency(latencyMs);
+	if (ui->chkTotalDuration->isChecked()) {
+		emit setAnimateDuration(latencyMs);
+	} else {
+		emit setAnimateLatency(latencyMs);
+	}
 }
 
 void LSystemUi::copyStatus()
@@ -925,6 +1232,15 @@ void LSystemUi::onLblStatusLinkActivated(const QString & link)
 		data->config = config;
 		getAdditionalOptionsForSegmentsMeta(data->meta);
 		invokeExec(data);
+	} else if (link == Links::OutOfCore) {
+		if (!lastDrawData) return;
+		disableConfigLiveEdit = true;
+		ui->chkOutOfCore->setCheckState(Qt::Checked);
+		disableConfigLiveEdit = false;
+		QSharedPointer<AllDrawData> data = QSharedPointer<AllDrawData>::create();
+		*data = *lastDrawData;
+		getAdditionalOptionsForSegmentsMeta(data->meta);
+		invokeExec(data);
 	} else if (link == Links::ShowSymbols) {
 		showSymbols();
 	} else if (link == Links::EditSettings) {
@@ -983,6 +1299,9 @@ void LSystemUi::onCmdResetDefaultOptionsClicked()
 	ui->chkAntiAliasing->setCheckState(Qt::Unchecked);
 	ui->chkShowLastIter->setCheckState(Qt::Unchecked);
 	ui->chkColorGradient->setCheckState(Qt::Unchecked);
+	ui->chkLevelOfDetail->setCheckState(Qt::Unchecked);
+	ui->chkDensity->setCheckState(Qt::Unchecked);
+	ui->chkOutOfCore->setCheckState(Qt::Unchecked);
 	ui->txtLastIterOpacity->setText("100");
 	ui->txtThickness->setText("1");
 	ui->txtOpacity->setText("100");
@@ -15,6 +15,7 @@
 #include <QMainWindow>
 #include <QMenu>
 #include <QShortcut>
+#include <QThreadPool>
 #include <QTimer>
 
 #include <optional>
@@ -30,12 +31,16 @@ class DrawArea;
 } // namespace lsystem::ui
 
 namespace lsystem {
+class AnimationExporter;
 class ConfigList;
 class ConfigFileStore;
 class DefinitionModel;
+class ExpansionCache;
+class PosterExporter;
 class SegmentAnimator;
 class SegmentDrawer;
 class Simulator;
+class VectorExporter;
 } // namespace lsystem
 
 class LSystemUi : public QMainWindow
@@ -46,6 +51,9 @@ public:
 	LSystemUi(QWidget * parent = nullptr);
 	~LSystemUi();
 
+protected:
+	void closeEvent(QCloseEvent * event) override;
+
 private:
 	enum class MsgType
 	{
@@ -59,7 +67,7 @@ private slots:
 	// from simulator
 	void processSimulatorSegments(const lsystem::common::ExecResult & execResult,
 								  const QSharedPointer<lsystem::common::AllDrawData> & data);
-	void processActionStr(const QString & actionStr);
+	void processSymbols(const lsystem::common::SymbolSourcePtr & symbols);
 
 	// from segdrawer
 	void drawDone(const QSharedPointer<lsystem::ui::Drawing> & drawing, const QSharedPointer<lsystem::common::AllDrawData> & data);
@@ -70,6 +78,11 @@ private slots:
 	void markingChanged();
 	void processDrawAction(const QString & link);
 	void showSymbols();
+	void exportAnimation(const QSharedPointer<lsystem::ui::Drawing> & drawing, const QColor & backColor);
+	void exportVector(const QList<QSharedPointer<lsystem::ui::Drawing>> & drawings, const QColor & backColor);
+	void exportPoster(const QList<QSharedPointer<lsystem::ui::Drawing>> & drawings, const QColor & backColor);
+	void saveDrawing(const QSharedPointer<lsystem::ui::Drawing> & drawing);
+	void loadDrawing(const QPoint & canvasPos);
 
 	// from different other components
 	void showErrorInUi(const QString & errString);
@@ -98,6 +111,7 @@ signals:
 	void startDraw(const lsystem::common::ExecResult & execResult, const QSharedPointer<lsystem::common::AllDrawData> & data);
 
 	void setAnimateLatency(std::chrono::milliseconds latency);
+	void setAnimateDuration(std::chrono::milliseconds duration);
 	void startAnimateCurrentDrawing();
 	void stopAnimate();
 	void goToAnimationStep(int step);
@@ -145,6 +159,9 @@ private:
 	DrawPlacement getDrawPlacement(const lsystem::ui::DrawingFrameSummary & drawingFrameResult) const;
 	void maximizeDrawing(const lsystem::ui::DrawingFrameSummary & drawing, std::optional<qint64> drawingNumToEdit, bool causedByLink);
 
+	// Session: placeholders are shown at once, the drawings are executed again in the background
+	void restoreSession();
+
 	// current Config
 	void configLiveEdit();
 	void execConfigLive(const lsystem::common::ConfigSet & configSet);
@@ -207,11 +224,22 @@ private:
 	QScopedPointer<lsystem::DefinitionModel> defModel;
 	QScopedPointer<lsystem::ConfigList> configList;
 	QScopedPointer<lsystem::ConfigFileStore> configFileStore;
+	QSharedPointer<lsystem::ExpansionCache> expansionCache;
 	QScopedPointer<lsystem::Simulator> simulator;
 	QThread simulatorThread;
 	QScopedPointer<lsystem::SegmentDrawer> segDrawer;
 	QThread segDrawerThread;
 	QScopedPointer<lsystem::SegmentAnimator> segAnimator;
+	QScopedPointer<lsystem::AnimationExporter> animExporter;
+	QScopedPointer<lsystem::VectorExporter> vectorExporter;
+	QScopedPointer<lsystem::PosterExporter> posterExporter;
+
+	struct RestoreInfo
+	{
+		QThreadPool pool; // only for the restore, such that pending drawings can be dropped on exit
+		int pending = 0;
+		int failed = 0;
+	} restore;
 
 	bool resultAvailable = false;
 	bool disableConfigLiveEdit = false;
@@ -1,8 +1,74 @@
 #include "lsystemui.h"
 
+#include <configfilestore.h>
+#include <simulator.h>
+#include <symbolexporter.h>
 #include <version.h>
 
 #include <QApplication>
+#include <QCommandLineParser>
+
+namespace {
+
+// Batch mode: writes the symbols of a stored config to a file without showing the UI.
+int exportSymbols(const QString & configName, const QString & fileName, const QString & iterations)
+{
+	QTextStream err(stderr);
+
+	lsystem::common::ConfigMap configs;
+	lsystem::ConfigFileStore configFileStore;
+	QObject::connect(&configFileStore,
+					 &lsystem::ConfigFileStore::loadedPreAndUserConfigs,
+					 [&configs](const lsystem::common::ConfigMap & preConfigs, const lsystem::common::ConfigMap & userConfigs) {
+						 configs = preConfigs;
+						 configs.insert(userConfigs);
+					 });
+	QObject::connect(&configFileStore, &lsystem::ConfigFileStore::showError, [&err](const QString & error) { err << error << Qt::endl; });
+	configFileStore.loadConfig();
+
+	if (!configs.contains(configName)) {
+		err << "unknown config: " << configName << Qt::endl;
+		return 1;
+	}
+
+	QSharedPointer<lsystem::common::AllDrawData> drawData = QSharedPointer<lsystem::common::AllDrawData>::create();
+	drawData->config = configs[configName];
+	drawData->meta.execActionStr = true;
+	if (!iterations.isEmpty()) {
+		bool ok;
+		drawData->config.numIter = iterations.toUInt(&ok);
+		if (!ok) {
+			err << "invalid number of iterations: " << iterations << Qt::endl;
+			return 1;
+		}
+	}
+
+	lsystem::common::SymbolSourcePtr symbols;
+	lsystem::Simulator simulator;
+	QObject::connect(&simulator, &lsystem::Simulator::errorReceived, [&err](const QString & error) { err << error << Qt::endl; });
+	QObject::connect(&simulator, &lsystem::Simulator::symbolsReceived, [&symbols](const lsystem::common::SymbolSourcePtr & received) {
+		symbols = received;
+	});
+	simulator.exec(drawData);
+	if (!symbols) return 1;
+
+	const quint64 size = symbols->size();
+	int lastPercent = -1;
+	const QString error = lsystem::SymbolExporter::exportSymbols(
+		*symbols, lsystem::SymbolExporter::formatFromFileName(fileName), fileName, [&](quint64 exported) {
+			const int percent = static_cast<int>(static_cast<long double>(exported) / size * 100);
+			if (percent != lastPercent) err << "\r" << (lastPercent = percent) << "%" << Qt::flush;
+			return true;
+		});
+	err << Qt::endl;
+	if (!error.isEmpty()) {
+		err << "export failed: " << error << Qt::endl;
+		return 1;
+	}
+	return 0;
+}
+
+} // namespace
 
 int main(int argc, char *argv[])
 {
@@ -10,14 +76,53 @@ int main(int argc, char *argv[])
 	qRegisterMetaType<lsystem::ui::Drawing>("lsystem::ui::Drawing");
 	qRegisterMetaType<lsystem::ui::Drawing>("ui::Drawing");
 
-	QApplication a(argc, argv);
+	QCommandLineParser parser;
+	const QCommandLineOption versionOption("version", "Show the version and exit.");
+	const QCommandLineOption exportSymbolsOption("export-symbols",
+												 "Write the symbols of <config> to the file given by --output and exit. "
+												 "Files ending with .gz are compressed, files ending with .rle run-length encoded.",
+												 "config");
+	const QCommandLineOption outputOption("output", "Output file for --export-symbols.", "file");
+	const QCommandLineOption iterationsOption("iterations", "Number of iterations for --export-symbols, instead of the stored one.", "n");
+	const QCommandLineOption helpOption = parser.addHelpOption();
+	parser.addOptions({versionOption, exportSymbolsOption, outputOption, iterationsOption});
 
-	if (a.arguments().contains("--version")) {
+	// The batch mode does not need a GUI (e.g., without a display), so its options are looked up before the application
+	// object exists. Any other arguments, like the Qt options -platform or -style, are left to QApplication.
+	const auto givenBeforeParsing = [argc, argv](const QCommandLineOption & option) {
+		for (int i = 1; i < argc; ++i) {
+			const QString arg = QString::fromLocal8Bit(argv[i]);
+			for (const QString & name : option.names()) {
+				const QString prefixedName = QString(name.size() == 1 ? "-" : "--") + name;
+				if (arg == prefixedName || arg.startsWith(prefixedName + "=")) return true;
+			}
+		}
+		return false;
+	};
+	const bool batchMode = givenBeforeParsing(helpOption) || givenBeforeParsing(QCommandLineOption("help-all"))
+						   || givenBeforeParsing(versionOption) || givenBeforeParsing(exportSymbolsOption);
+	if (!batchMode) {
+		QApplication a(argc, argv);
+		LSystemUi w;
+		w.show();
+		return a.exec();
+	}
+
+	// errors and the help are handled by `process`
+	QCoreApplication a(argc, argv);
+	parser.process(a);
+
+	if (parser.isSet(versionOption)) {
 		QTextStream(stdout) << "lsystem version " << lsystem::common::Version << Qt::endl;
 		return 0;
 	}
 
-	LSystemUi w;
-	w.show();
-	return a.exec();
+	if (parser.isSet(exportSymbolsOption)) {
+		if (!parser.isSet(outputOption)) {
+			QTextStream(stderr) << "--export-symbols requires --output" << Qt::endl;
+			return 1;
+		}
+		return exportSymbols(parser.value(exportSymbolsOption), parser.value(outputOption), parser.value(iterationsOption));
+	}
+	return 0;
 }
@@ -0,0 +1,140 @@
+#include "posterexporter.h"
+
+#include <util/pngstreamwriter.h>
+
+#include <QQueue>
+#include <QtConcurrent>
+#include <QtMath>
+
+using lsystem::ui::PngStreamWriter;
+
+namespace {
+
+QRect canvasRectOf(const QList<lsystem::VectorExportItem> & items)
+{
+	QRect rv;
+	for (const lsystem::VectorExportItem & item : items) rv |= item.canvasRect;
+	return rv;
+}
+
+// renders the rows [top, top + height) of the output image
+QImage renderBand(
+	const QList<lsystem::VectorExportItem> & items, const QColor & backColor, double scale, const QRect & rect, int top, int height)
+{
+	QImage rv(QSize(qCeil(rect.width() * scale), height), QImage::Format_RGB32);
+	rv.fill(backColor);
+
+	// band in canvas coordinates, for culling the segment chunks
+	const QRectF bandRect(rect.left(), rect.top() + top / scale, rect.width(), height / scale);
+
+	QPainter painter(&rv);
+	painter.translate(0, -top);
+	painter.scale(scale, scale);
+	painter.translate(-rect.topLeft());
+	painter.setRenderHint(QPainter::SmoothPixmapTransform);
+
+	for (const lsystem::VectorExportItem & item : items) {
+		if (!bandRect.intersects(item.canvasRect)) continue;
+		const lsystem::ui::Drawing & drawing = *item.drawing;
+		if (drawing.mainMeta.densityMode) {
+			item.densityImage.drawTo(painter, item.canvasRect.topLeft(), bandRect.toAlignedRect());
+			continue;
+		}
+
+		painter.save();
+		// image coordinates of the drawing
+		painter.translate(item.canvasRect.topLeft());
+		for (const bool lastIter : {true, false}) {
+			const QVector<QRectF> & chunkBounds = lastIter ? drawing.lastIterChunkBounds : drawing.chunkBounds;
+			const qint64 numSegs = lastIter ? drawing.segmentsLastIter.size() : drawing.segmentCount();
+			for (int chunk = 0; chunk < chunkBounds.size(); ++chunk) {
+				if (!chunkBounds[chunk].translated(item.offset).intersects(bandRect)) continue;
+				const qint64 numStart = static_cast<qint64>(chunk) * lsystem::ui::Drawing::ChunkSize;
+				const qint64 numEnd = qMin<qint64>(numStart + lsystem::ui::Drawing::ChunkSize, numSegs) - 1;
+				drawing.paintVectorRange(painter, lastIter, numStart, numEnd);
+			}
+		}
+		painter.restore();
+	}
+	return rv;
+}
+
+} // namespace
+
+namespace lsystem {
+
+PosterExporter::PosterExporter()
+{
+	connect(&watcher, &QFutureWatcher<QString>::finished, this, [this]() { emit finished(watcher.result()); });
+}
+
+PosterExporter::~PosterExporter()
+{
+	cancel();
+	watcher.waitForFinished();
+}
+
+QSize PosterExporter::outputSize(const QList<VectorExportItem> & items, double scale)
+{
+	const QRect rect = canvasRectOf(items);
+	return QSize(qCeil(rect.width() * scale), qCeil(rect.height() * scale));
+}
+
+void PosterExporter::start(const QList<VectorExportItem> & items, const QColor & backColor, double scale, const QString & fileName)
+{
+	if (isActive()) {
+		emit finished("an export is already running");
+		return;
+	}
+	cancelRequested = false;
+	watcher.setFuture(
+		QtConcurrent::run([this, items, backColor, scale, fileName]() { return run(items, backColor, scale, fileName); }));
+}
+
+void PosterExporter::cancel() { cancelRequested = true; }
+
+QString PosterExporter::run(const QList<VectorExportItem> & items, const QColor & backColor, double scale, const QString & fileName)
+{
+	const QRect rect = canvasRectOf(items);
+	const QSize size = outputSize(items, scale);
+	if (size.isEmpty()) return "nothing to export";
+	if (size.width() > MaxSize || size.height() > MaxSize) return QString("the image must not be larger than %1 pixels").arg(MaxSize);
+
+	PngStreamWriter writer;
+	if (!writer.open(fileName, size)) return writer.errorString();
+
+	// Bands are rendered and compressed on the thread pool, the writer takes them in order.
+	const int bandCount = (size.height() + BandHeight - 1) / BandHeight;
+	const int maxInFlight = qMax(2, QThread::idealThreadCount());
+	QQueue<QFuture<PngStreamWriter::DeflatedBand>> inFlight;
+	int nextBand = 0;
+	QString error;
+	for (int band = 0; band < bandCount && error.isEmpty(); ++band) {
+		while (nextBand < bandCount && inFlight.size() < maxInFlight) {
+			const int top = nextBand * BandHeight;
+			const int height = qMin(BandHeight, size.height() - top);
+			const bool lastBand = nextBand == bandCount - 1;
+			inFlight.enqueue(QtConcurrent::run([items, backColor, scale, rect, top, height, lastBand]() {
+				return PngStreamWriter::deflateBand(renderBand(items, backColor, scale, rect, top, height), lastBand);
+			}));
+			++nextBand;
+		}
+
+		if (cancelRequested) {
+			error = "export cancelled";
+		} else if (!writer.addBand(inFlight.dequeue().result())) {
+			error = writer.errorString();
+		}
+		emit progress(band + 1, bandCount);
+	}
+
+	if (!error.isEmpty()) {
+		for (auto & future : inFlight) future.waitForFinished();
+		writer.abort();
+		return error;
+	}
+	if (!writer.finish()) return writer.errorString();
+	return QString();
+}
+
+} // namespace lsystem
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vectorexporter.h>
+
+#include <QFutureWatcher>
+#include <QObject>
+
+#include <atomic>
+
+namespace lsystem {
+
+// Exports drawings as PNG at a scale factor, for sizes which do not fit into a single image (e.g., posters).
+// The image is rendered from the segments in bands of BandHeight rows, which are rendered and compressed
+// in parallel ahead of the writer. Only the bands in flight are kept in memory.
+class PosterExporter : public QObject
+{
+	Q_OBJECT
+public:
+	static const constexpr int BandHeight = 256;
+	static const constexpr int MaxSize = 65535;
+
+	PosterExporter();
+	~PosterExporter();
+
+	bool isActive() const { return watcher.isRunning(); }
+	static QSize outputSize(const QList<lsystem::VectorExportItem> & items, double scale);
+
+public slots:
+	void start(const QList<lsystem::VectorExportItem> & items, const QColor & backColor, double scale, const QString & fileName);
+	void cancel();
+
+signals:
+	void progress(int band, int bandCount);
+	// `errorString` is empty on success
+	void finished(const QString & errorString);
+
+private:
+	QString run(const QList<VectorExportItem> & items, const QColor & backColor, double scale, const QString & fileName);
+
+private:
+	QFutureWatcher<QString> watcher;
+	std::atomic_bool cancelRequested = false;
+};
+
+} // namespace lsystem
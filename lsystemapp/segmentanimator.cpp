@@ -4,6 +4,13 @@
 
 using namespace lsystem::common;
 
+namespace {
+
+// about 60 frames per second
+constexpr int MinFrameIntervalMs = 16;
+
+} // namespace
+
 namespace lsystem {
 
 SegmentAnimator::SegmentAnimator()
@@ -15,33 +22,76 @@ SegmentAnimator::SegmentAnimator()
 
 void SegmentAnimator::startAnimateCurrentDrawing()
 {
+	schedule.started = false;
 	run();
 }
 
 void SegmentAnimator::setAnimateLatency(std::chrono::milliseconds latency)
 {
-	if (latency.count() > 0)
+	if (latency.count() > 0) {
 		latencyMs = latency.count();
+		durationMs = 0;
+		restartSchedule();
+	}
+}
+
+void SegmentAnimator::setAnimateDuration(std::chrono::milliseconds duration)
+{
+	if (duration.count() > 0) {
+		durationMs = duration.count();
+		restartSchedule();
+	}
 }
 
 void SegmentAnimator::stopAnimate()
 {
 	drawTimer.stop();
+	schedule.started = false;
 }
 
 void SegmentAnimator::run()
 {
-	const auto startOfRun = QTime::currentTime();
+	QElapsedTimer renderTime;
+	renderTime.start();
 
-	const auto res = emit newAnimationStep(1, true);
+	AnimatorResult res;
+	if (!schedule.started) {
+		res = emit newAnimationStep(1, true);
+		schedule.started = true;
+		schedule.clock.start();
+		schedule.startStep = res.step;
+	} else {
+		// all segments which are due until now, at least one
+		const int targetStep = schedule.startStep + static_cast<int>(schedule.clock.elapsed() * stepsPerMs());
+		res = emit newAnimationStep(qMax(1, targetStep - schedule.lastStep), true);
+	}
+	schedule.lastStep = res.step;
+	schedule.stepCount = res.stepCount;
 
-	const bool stopped = res.nextStepResult == AnimatorResult::NextStepResult::Stopped;
-	if (!stopped) {
-		const int reaminingLatencyMs = qMax(0, latencyMs - startOfRun.msecsTo(QTime::currentTime()));
-		drawTimer.start(reaminingLatencyMs);
+	if (res.nextStepResult == AnimatorResult::NextStepResult::Stopped) {
+		schedule.started = false;
+		return;
 	}
+
+	// Rendering time counts into the frame interval. If it is exceeded, the next frame is started immediately.
+	drawTimer.start(qMax(0, frameIntervalMs() - static_cast<int>(renderTime.elapsed())));
+}
+
+void SegmentAnimator::restartSchedule()
+{
+	if (!schedule.started) return;
+	schedule.clock.restart();
+	schedule.startStep = schedule.lastStep;
 }
 
+double SegmentAnimator::stepsPerMs() const
+{
+	if (durationMs > 0) return static_cast<double>(schedule.stepCount) / durationMs;
+	return 1. / latencyMs;
+}
+
+int SegmentAnimator::frameIntervalMs() const { return durationMs > 0 ? MinFrameIntervalMs : qMax(MinFrameIntervalMs, latencyMs); }
+
 void SegmentAnimator::goToAnimationStep(int step) { emit newAnimationStep(step, false); }
 
 } // namespace lsystem
@@ -2,6 +2,7 @@
 
 #include <common.h>
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QTimer>
 
@@ -12,6 +13,9 @@ class DrawArea;
 class Drawing;
 };
 
+// Advances the animation according to the elapsed time: either with a fixed latency per segment or within a total duration.
+// With short latencies several segments are added per frame. If rendering a frame takes longer than the frame interval,
+// frames are dropped and the next frame catches up with the schedule.
 class SegmentAnimator : public QObject
 {
 	Q_OBJECT
@@ -21,6 +25,7 @@ public:
 public slots:
 	void startAnimateCurrentDrawing();
 	void setAnimateLatency(std::chrono::milliseconds latency);
+	void setAnimateDuration(std::chrono::milliseconds duration);
 	void stopAnimate();
 	void goToAnimationStep(int step);
 
@@ -30,10 +35,23 @@ signals:
 
 private:
 	void run();
+	void restartSchedule();
+	double stepsPerMs() const;
+	int frameIntervalMs() const;
 
 private:
 	QTimer drawTimer;
 	int latencyMs = 500;
+	int durationMs = 0; // if set, the latency is ignored
+
+	struct Schedule final
+	{
+		bool started = false;
+		QElapsedTimer clock;
+		int startStep = 0;
+		int lastStep = 0;
+		int stepCount = 0;
+	} schedule;
 };
 
 } // namespace lsystem
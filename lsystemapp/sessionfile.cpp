@@ -0,0 +1,115 @@
+#include "sessionfile.h"
+
+#include <jsonkeys.h>
+
+#include <QSaveFile>
+
+using namespace lsystem::common;
+using namespace lsystem::constants;
+
+namespace {
+
+QJsonArray pointToJson(const QPoint & point) { return QJsonArray{point.x(), point.y()}; }
+
+QPoint pointFromJson(const QJsonValue & value)
+{
+	const QJsonArray array = value.toArray();
+	return QPoint(array.at(0).toInt(), array.at(1).toInt());
+}
+
+} // namespace
+
+namespace lsystem {
+
+SessionFile::Session SessionFile::fromDrawings(const ui::DrawingCollection & drawings)
+{
+	Session rv;
+	rv.markedDrawing = drawings.getMarkedDrawingNum();
+	rv.backColor = drawings.backColor;
+	for (const QSharedPointer<ui::Drawing> & drawing : drawings.getDrawingsInZOrder()) {
+		Entry entry;
+		entry.data = QSharedPointer<AllDrawData>::create();
+		entry.data->config = drawing->config;
+		entry.data->meta = drawing->meta();
+		entry.data->uiDrawData.offset = drawing->offset;
+		entry.data->uiDrawData.drawingNumToEdit = drawing->num;
+		entry.bounds = drawing->canvasRect().translated(-drawing->offset);
+		rv.entries << entry;
+	}
+	return rv;
+}
+
+QString SessionFile::save(const Session & session, const QString & fileName)
+{
+	QJsonArray jsonDrawings;
+	for (const Entry & entry : session.entries) {
+		const ConfigSet & config = entry.data->config;
+		QJsonObject jsonDrawing;
+		jsonDrawing[JsonKeyNum] = *entry.data->uiDrawData.drawingNumToEdit;
+		jsonDrawing[JsonKeyName] = config.name;
+		jsonDrawing[JsonKeyConfigs] = config.toJson();
+		if (config.overrideStackSize) jsonDrawing[JsonKeyStackSize] = *config.overrideStackSize;
+		jsonDrawing[JsonKeyMeta] = entry.data->meta.toJson();
+		jsonDrawing[JsonKeyOffset] = pointToJson(entry.data->uiDrawData.offset);
+		jsonDrawing[JsonKeyBounds] = QJsonArray{pointToJson(entry.bounds.topLeft()), pointToJson(entry.bounds.bottomRight())};
+		jsonDrawings << jsonDrawing;
+	}
+
+	QJsonObject json;
+	json[JsonKeyVersion] = static_cast<int>(Version);
+	json[JsonKeyBackColor] = session.backColor.name(QColor::HexArgb);
+	json[JsonKeyMarked] = session.markedDrawing;
+	json[JsonKeyDrawings] = jsonDrawings;
+
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly)) return file.errorString();
+	file.write(QJsonDocument(json).toJson());
+	if (!file.commit()) return file.errorString();
+	return QString();
+}
+
+SessionFile::LoadResult SessionFile::load(const QString & fileName)
+{
+	LoadResult rv;
+	QFile file(fileName);
+	if (!file.exists()) return rv;
+	if (!file.open(QIODevice::ReadOnly)) {
+		rv.error = file.errorString();
+		return rv;
+	}
+
+	QJsonParseError err;
+	const QJsonObject json = QJsonDocument::fromJson(file.readAll(), &err).object();
+	if (err.error != QJsonParseError::NoError) {
+		rv.error = "invalid session file: " + err.errorString();
+		return rv;
+	}
+	if (json[JsonKeyVersion].toInt() != static_cast<int>(Version)) {
+		rv.error = QString("unsupported version %1 of the session file").arg(json[JsonKeyVersion].toInt());
+		return rv;
+	}
+
+	rv.session.backColor = QColor(json[JsonKeyBackColor].toString());
+	rv.session.markedDrawing = json[JsonKeyMarked].toInteger();
+	for (const QJsonValue & value : json[JsonKeyDrawings].toArray()) {
+		const QJsonObject jsonDrawing = value.toObject();
+		Entry entry;
+		entry.data = QSharedPointer<AllDrawData>::create();
+		ConfigSet & config = entry.data->config;
+		config = ConfigSet(jsonDrawing[JsonKeyConfigs].toObject());
+		config.name = jsonDrawing[JsonKeyName].toString();
+		config.valid = !config.definitions.isEmpty();
+		if (jsonDrawing.contains(JsonKeyStackSize)) config.overrideStackSize = jsonDrawing[JsonKeyStackSize].toInt();
+		entry.data->meta = MetaData(jsonDrawing[JsonKeyMeta].toObject());
+		entry.data->meta.execSegments = true;
+		entry.data->uiDrawData.offset = pointFromJson(jsonDrawing[JsonKeyOffset]);
+		entry.data->uiDrawData.drawingNumToEdit = jsonDrawing[JsonKeyNum].toInt();
+		entry.data->uiDrawData.resultOk = true;
+		const QJsonArray bounds = jsonDrawing[JsonKeyBounds].toArray();
+		entry.bounds = QRect(pointFromJson(bounds.at(0)), pointFromJson(bounds.at(1)));
+		if (entry.data->uiDrawData.drawingNumToEdit > 0 && config.valid && entry.bounds.isValid()) rv.session.entries << entry;
+	}
+	return rv;
+}
+
+} // namespace lsystem
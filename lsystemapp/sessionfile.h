@@ -0,0 +1,40 @@
+#pragma once
+
+#include <drawingcollection.h>
+
+namespace lsystem {
+
+// Session of the canvas as JSON: configs, meta data, offsets, bounds and z-order of the drawings, but no segments.
+// The drawings are restored by executing their configs again, the bounds are for placeholders in the meantime.
+class SessionFile final
+{
+public:
+	static const constexpr quint32 Version = 1;
+	static const constexpr char * DefaultFileName = "session.json";
+
+	struct Entry
+	{
+		QSharedPointer<common::AllDrawData> data; // drawing number and offset in `uiDrawData`
+		QRect bounds;							  // drawing coordinates
+	};
+
+	struct Session
+	{
+		QList<Entry> entries; // in z-order, bottom first
+		qint64 markedDrawing = 0;
+		QColor backColor;
+	};
+
+	struct LoadResult
+	{
+		QString error; // empty on success
+		Session session;
+	};
+
+	static Session fromDrawings(const ui::DrawingCollection & drawings);
+	static QString save(const Session & session, const QString & fileName);
+	// A missing file is an empty session.
+	static LoadResult load(const QString & fileName);
+};
+
+} // namespace lsystem
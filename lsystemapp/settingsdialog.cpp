@@ -13,6 +13,8 @@ SettingsDialog::SettingsDialog(QWidget * parent, lsystem::ConfigFileStore * cfgS
 	//setFixedSize(size());
 
 	ui->txtStackSize->setText(QString::number(cfgStore->getSettings().maxStackSize));
+	ui->txtUndoMemory->setText(QString::number(cfgStore->getSettings().undoMemoryMb));
+	ui->chkPixelAccurateHitTest->setChecked(cfgStore->getSettings().pixelAccurateHitTest);
 }
 
 SettingsDialog::~SettingsDialog()
@@ -22,12 +24,13 @@ SettingsDialog::~SettingsDialog()
 
 void SettingsDialog::accept()
 {
-	bool ok;
-	const quint32 newStackSize = ui->txtStackSize->text().toUInt(&ok);
-	if (ok) {
-		settings.maxStackSize = newStackSize;
-		cfgStore->saveSettings(settings);
-	}
+	bool okStackSize, okUndoMemory;
+	const quint32 newStackSize = ui->txtStackSize->text().toUInt(&okStackSize);
+	const quint32 newUndoMemory = ui->txtUndoMemory->text().toUInt(&okUndoMemory);
+	if (okStackSize) settings.maxStackSize = newStackSize;
+	if (okUndoMemory) settings.undoMemoryMb = newUndoMemory;
+	settings.pixelAccurateHitTest = ui->chkPixelAccurateHitTest->isChecked();
+	cfgStore->saveSettings(settings);
 	close();
 }
 
@@ -1,10 +1,32 @@
 #include "simulator.h"
 
+#include <expansioncache.h>
 #include <util/print.h>
 #include <util/qtcontutils.h>
 
+#include <QtConcurrent>
+
 using namespace util;
 
+namespace {
+
+// Subtrees with a smaller extent (in pixels) are collapsed to one segment.
+constexpr double LodThresholdPx = 1.0;
+
+// Limit for the recursion depth of the level of detail, deeper configs are expanded as usual.
+constexpr quint32 LodMaxIterations = 1000;
+
+// Limit for the symbols, the lengths are stored per depth.
+constexpr quint32 SymbolsMaxIterations = 10000;
+
+// Multiplication of points interpreted as complex numbers, i.e., rotation and scaling of `lhs` by `rhs`.
+QPointF complexMul(const QPointF & lhs, const QPointF & rhs)
+{
+	return QPointF(lhs.x() * rhs.x() - lhs.y() * rhs.y(), lhs.x() * rhs.y() + lhs.y() * rhs.x());
+}
+
+} // namespace
+
 namespace lsystem {
 
 using namespace common;
@@ -82,30 +104,66 @@ void Simulator::exec(const QSharedPointer<AllDrawData> & data)
 	// The actual expansion is equal if:
 	// * the expanded actions are equal,
 	// * and the execution was not stopped due to StackSize.
-	const bool executedSameExpansion = expandedActionsEqual && !stackSizeLimitReached;
-
-	if (!executedSameExpansion) actionStr = "";
+	const bool executedSameExpansion = expanded && expandedActionsEqual && !stackSizeLimitReached;
 
 	// Check for valid config and parse the actions.
 	if (!(validConfig && expandedActionsEqual)) {
 		// parseAction raises errorReceived
 		validConfig = parseActions(newConfig);
+		// the previous expansion refers to the old actions
+		expanded = false;
+		currentActions.clear();
+		subtreeGeoms.clear();
 		if (!validConfig) {
 			if (meta.execSegments) emit segmentsReceived(ExecResult{ExecResult::ExecResultKind::InvalidConfig}, data);
-			if (meta.execActionStr) emit actionStrReceived("(error occurred)");
+			if (meta.execActionStr) emit symbolsReceived({});
 			return;
 		}
 	}
 
+	if (meta.execSegments) {
+		ExecResult res{ExecResult::ExecResultKind::Ok, actionColors};
+		res.iterNum = config.numIter;
+
+		if (meta.outOfCore) {
+			execOutOfCore(newConfig, res);
+		} else if (meta.levelOfDetail && newConfig.numIter <= LodMaxIterations) {
+			// The subtree geometries do not need the expansion, only the parsed actions.
+			if (!expanded) config = newConfig;
+			execLevelOfDetail(newConfig, meta, res);
+		} else {
+			execExpansion(newConfig, executedSameExpansion, meta, res);
+		}
+		emit segmentsReceived(res, data);
+
+		// Stored in the background, such that the next execution is not delayed by the disk.
+		// The segments are implicitly shared with the result and never modified, i.e., not copied.
+		if (uncachedKey) {
+			ExpansionCache::Entry entry{res.segments, std::nullopt};
+			if (meta.showLastIter) entry.segmentsLastIter = res.segmentsLastIter;
+			QtConcurrent::run([cache = expansionCache, key = *uncachedKey, entry]() { cache->store(key, entry); });
+			uncachedKey.reset();
+		}
+	}
+
+	// The symbols are composed on demand from the parsed actions, the expansion is not needed.
+	if (meta.execActionStr) {
+		if (newConfig.numIter > SymbolsMaxIterations) {
+			emit errorReceived(QString("The symbols can be shown for at most %1 iterations").arg(SymbolsMaxIterations));
+			emit symbolsReceived({});
+		} else {
+			emit symbolsReceived(createSymbolSource(newConfig.numIter));
+		}
+	}
+}
+
+void Simulator::execExpansion(const ConfigSet & newConfig, bool executedSameExpansion, const MetaData & meta, ExecResult & res)
+{
 	// We don't need the full execIterations if:
 	// * we don't show the last iteration (for this we need the loop in `execIterations`),
-	//  - only relevant if segments are shown, there is no "show last iteration for action strings"
 	// * and the actual expansion is equal (see above).
 
-	ExecResult res{ExecResult::ExecResultKind::Ok, actionColors};
-	res.iterNum = config.numIter;
-
-	if (executedSameExpansion && !(meta.showLastIter && meta.execSegments)) {
+	if (executedSameExpansion && !meta.showLastIter) {
 		if (config == newConfig) {
 			// If the configs are completely identical, we just use the last result:
 			res.segments = segments;
@@ -115,26 +173,106 @@ void Simulator::exec(const QSharedPointer<AllDrawData> & data)
 			config = newConfig;
 			res.segments = getSegments();
 		}
-		// Action String cannot change in this case, only recalculate if not present.
-		if (meta.execActionStr && actionStr.isEmpty()) composeActionStr();
 	} else {
-		// We have to reprocess everything.
-		// Iterations are needed for segments and action string.
+		// We have to reprocess everything, unless the segments are cached.
 		config = newConfig;
+		if (loadCachedExpansion(meta, res)) return;
+
 		execIterations(meta, res);
+		expanded = true;
+		if (expansionCache && res.resultKind == ExecResult::ExecResultKind::Ok && res.segments.size() >= ExpansionCache::MinSegments) {
+			uncachedKey = ExpansionCache::fingerprint(config);
+		}
+	}
+}
+
+bool Simulator::loadCachedExpansion(const MetaData & meta, ExecResult & res)
+{
+	if (!expansionCache) return false;
+
+	const std::optional<ExpansionCache::Entry> entry = expansionCache->load(ExpansionCache::fingerprint(config));
+	// the expansion would exceed the stack size, if already the segments do
+	if (!entry || (meta.showLastIter && !entry->segmentsLastIter) || entry->segments.size() > curMaxStackSize) return false;
+
+	// the actions are not expanded, the next execution loads the cache again or expands
+	expanded = false;
+	stackSizeLimitReached = false;
+	segments = entry->segments;
+	res.segments = entry->segments;
+	if (meta.showLastIter) res.segmentsLastIter = *entry->segmentsLastIter;
+	res.iterNum = config.numIter;
+	return true;
+}
+
+void Simulator::execOutOfCore(const ConfigSet & newConfig, ExecResult & res)
+{
+	// Only the path from the start action to the current literal is kept in memory, not the actions of a whole iteration.
+	// The last iteration is not available, as it would need a second walk.
+	struct Frame
+	{
+		const ProcessLiteralAction * action;
+		quint32 depth; // remaining expansions
+		qsizetype pos;
+	};
+
+	config = newConfig;
+	expanded = false;
+	currentActions.clear();
+	segments.clear();
+
+	const QSharedPointer<SegmentSpill> newSpill = QSharedPointer<SegmentSpill>::create();
+	spill = newSpill.data();
+
+	const double startTurn = qDegreesToRadians(config.startAngle);
+	TurnAction initialTurnAct(*this, std::cos(startTurn), std::sin(startTurn), '\0');
+	State state;
+	state.d.setX(config.stepSize);
+	initialTurnAct.exec(state);
+
+	QStack<Frame> stack;
+	if (config.numIter == 0) startAction->exec(state);
+	else stack.push({startAction.data(), config.numIter, 0});
 
-		if (meta.execActionStr) composeActionStr();
+	while (!stack.isEmpty() && newSpill->errorString().isEmpty()) {
+		Frame & frame = stack.top();
+		if (frame.pos == frame.action->subActions.size()) {
+			stack.pop();
+			continue;
+		}
+		const Action * subAction = frame.action->subActions[frame.pos++].data();
+		const ProcessLiteralAction * literalAction = subAction->asLiteralAction();
+		if (literalAction && frame.depth > 1) stack.push({literalAction, frame.depth - 1, 0});
+		else subAction->exec(state);
 	}
 
-	// Finally report the results.
-	if (meta.execSegments) emit segmentsReceived(res, data);
-	if (meta.execActionStr) emit actionStrReceived(actionStr);
+	spill = nullptr;
+	if (!newSpill->finish()) {
+		res.resultKind = ExecResult::ExecResultKind::ExceedStackSize;
+		emit errorReceived(
+			QString("Stopped the out-of-core expansion after %1 segments: %2").arg(newSpill->size()).arg(newSpill->errorString()));
+	}
+	stackSizeLimitReached = false;
+	res.iterNum = config.numIter;
+	res.spilledSegments = newSpill;
 }
 
-void Simulator::composeActionStr()
+SymbolSourcePtr Simulator::createSymbolSource(quint32 depth) const
 {
-	actionStr = "";
-	for (const Action * action : std::as_const(currentActions)) actionStr += print(action);
+	QMap<char, int> ruleIndices;
+	for (const DynProcessLiteralAction & action : mainActions) ruleIndices.insert(action->getLiteral(), ruleIndices.size());
+
+	QVector<SymbolSource::Rule> rules;
+	for (const DynProcessLiteralAction & action : mainActions) {
+		SymbolSource::Rule rule;
+		for (const DynAction & subAction : std::as_const(action->subActions)) {
+			const ProcessLiteralAction * literalAction = subAction->asLiteralAction();
+			rule << SymbolSource::Symbol{subAction->getLiteral(), literalAction ? ruleIndices[literalAction->getLiteral()] : -1};
+		}
+		rules << rule;
+	}
+
+	const SymbolSource::Symbol start{startAction->getLiteral(), ruleIndices[startAction->getLiteral()]};
+	return SymbolSourcePtr::create(rules, start, depth);
 }
 
 void Simulator::execIterations(const common::MetaData & meta, ExecResult & res)
@@ -150,11 +288,13 @@ void Simulator::execIterations(const common::MetaData & meta, ExecResult & res)
 			stackSizeLimitReached = true;
 			emit errorReceived(QString("Exceeded maximum stack size (%1) at iteration %2, <a "
 									   "href=\"%3\">Paint with stack size %4</a>, <a "
-									   "href=\"%5\">Edit settings</a>")
+									   "href=\"%5\">Paint out of core</a>, <a "
+									   "href=\"%6\">Edit settings</a>")
 								   .arg(curMaxStackSize)
 								   .arg(res.iterNum)
 								   .arg(Links::NextIterations)
 								   .arg(2 * curMaxStackSize)
+								   .arg(Links::OutOfCore)
 								   .arg(Links::EditSettings));
 			return;
 		} else if (meta.showLastIter && curIter == config.numIter - 1) {
@@ -203,11 +343,106 @@ LineSegs Simulator::getSegments()
 	return segments;
 }
 
+void Simulator::execLevelOfDetail(const ConfigSet & newConfig, const MetaData & meta, ExecResult & res)
+{
+	calcSubtreeGeoms(newConfig.numIter);
+
+	res.iterNum = newConfig.numIter;
+	bool ok = getSegmentsLod(newConfig, newConfig.numIter, res.segments);
+	if (ok && meta.showLastIter && newConfig.numIter > 0) ok = getSegmentsLod(newConfig, newConfig.numIter - 1, res.segmentsLastIter);
+
+	if (!ok) {
+		res.resultKind = ExecResult::ExecResultKind::ExceedStackSize;
+		emit errorReceived(QString("Exceeded maximum stack size (%1) with level of detail, <a href=\"%2\">Edit settings</a>")
+							   .arg(curMaxStackSize)
+							   .arg(Links::EditSettings));
+	}
+}
+
+void Simulator::calcSubtreeGeoms(quint32 maxDepth)
+{
+	// The geometries of depth n are composed from the geometries of depth n-1 of the sub actions,
+	// so the costs are linear in the depth and not in the size of the expansion.
+	for (quint32 depth = subtreeGeoms.isEmpty() ? 0 : subtreeGeoms.first().size(); depth <= maxDepth; ++depth) {
+		for (const DynProcessLiteralAction & action : std::as_const(mainActions)) {
+			SubtreeGeom geom;
+			if (depth == 0) {
+				if (action->getMove()) geom.end = QPointF(1, 0);
+				geom.radius = action->getMove() ? 1 : 0;
+				geom.paints = action->getPaint();
+			} else {
+				State state;
+				state.d = QPointF(1, 0);
+				for (const DynAction & subAction : std::as_const(action->subActions)) {
+					const ProcessLiteralAction * literalAction = subAction->asLiteralAction();
+					if (!literalAction) {
+						subAction->exec(state);
+						continue;
+					}
+					const SubtreeGeom & subGeom = subtreeGeoms[literalAction->getLiteral()][depth - 1];
+					const double dLength = std::hypot(state.d.x(), state.d.y());
+					geom.radius = qMax(geom.radius, std::hypot(state.cur.x(), state.cur.y()) + dLength * subGeom.radius);
+					geom.paints |= subGeom.paints;
+					state.cur += complexMul(state.d, subGeom.end);
+					state.d = complexMul(state.d, subGeom.dir);
+				}
+				geom.end = state.cur;
+				geom.dir = state.d;
+			}
+			subtreeGeoms[action->getLiteral()] << geom;
+		}
+	}
+}
+
+bool Simulator::getSegmentsLod(const ConfigSet & newConfig, quint32 depth, LineSegs & segs)
+{
+	const double startTurn = qDegreesToRadians(newConfig.startAngle);
+	TurnAction initialTurnAct(*this, std::cos(startTurn), std::sin(startTurn), '\0');
+	State state;
+	state.d.setX(newConfig.stepSize);
+	initialTurnAct.exec(state);
+
+	return execLodRecursive(startAction.data(), depth, state, segs);
+}
+
+bool Simulator::execLodRecursive(const ProcessLiteralAction * action, quint32 depth, State & state, LineSegs & segs)
+{
+	if (segs.size() > curMaxStackSize) return false;
+
+	const SubtreeGeom & geom = subtreeGeoms[action->getLiteral()][depth];
+	const double extent = 2 * std::hypot(state.d.x(), state.d.y()) * geom.radius;
+
+	if (depth == 0 || !geom.paints || extent < LodThresholdPx) {
+		// Collapse the subtree to one segment (or point), or only move if nothing is painted.
+		const QPointF lastCur = state.cur;
+		state.cur += complexMul(state.d, geom.end);
+		state.d = complexMul(state.d, geom.dir);
+		if (geom.paints) segs << LineSeg{.start = lastCur, .end = state.cur, .colorNum = action->getColorNum()};
+		return true;
+	}
+
+	for (const DynAction & subAction : std::as_const(action->subActions)) {
+		const ProcessLiteralAction * literalAction = subAction->asLiteralAction();
+		if (literalAction) {
+			if (!execLodRecursive(literalAction, depth - 1, state, segs)) return false;
+		} else {
+			subAction->exec(state);
+		}
+	}
+	return true;
+}
+
 void Simulator::setMaxStackSize(int newMaxStackSize) { maxStackSize = newMaxStackSize; }
 
+void Simulator::setExpansionCache(const QSharedPointer<ExpansionCache> & cache) { expansionCache = cache; }
+
 void Simulator::addAction(const Action * action) { nextActions << action; }
 
-void Simulator::addSegment(const LineSeg & seg) { segments << seg; }
+void Simulator::addSegment(const LineSeg & seg)
+{
+	if (spill) spill->append(seg);
+	else segments << seg;
+}
 
 bool Simulator::parseActions(const ConfigSet & newConfig)
 {
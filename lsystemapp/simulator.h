@@ -4,6 +4,8 @@
 
 namespace lsystem {
 
+class ExpansionCache;
+
 namespace impl {
 
 class Action;
@@ -25,6 +27,17 @@ struct State : public StateGeom
 
 using States = QList<State>;
 
+// Effect of a fully expanded literal on the state, independent of the start position and direction.
+// With the direction `d` as complex number, the subtree moves from `cur` to `cur + d * end`,
+// leaves the direction `d * dir` and stays within the radius `|d| * radius` around `cur`.
+struct SubtreeGeom
+{
+	QPointF end;
+	QPointF dir{1, 0};
+	double radius = 0;
+	bool paints = false;
+};
+
 // ----------------------------------------------------------------------
 
 class SimlatorInterface
@@ -46,6 +59,7 @@ public:
 
 	virtual void expand() const;
 	virtual void exec(State & state) const = 0;
+	virtual const ProcessLiteralAction * asLiteralAction() const { return nullptr; }
 	char getLiteral() const { return literal; }
 	QString toString() const { return QString(1, literal); }
 
@@ -68,6 +82,11 @@ public:
 
 	void expand() const override;
 	void exec(State & state) const override;
+	const ProcessLiteralAction * asLiteralAction() const override { return this; }
+
+	quint8 getColorNum() const { return colorNum; }
+	bool getPaint() const { return paint; }
+	bool getMove() const { return move; }
 
 public:
 	DynActionList subActions;
@@ -134,7 +153,12 @@ class Simulator : public QObject, public impl::SimlatorInterface
 signals:
 	void errorReceived(const QString & errStr);
 	void segmentsReceived(const common::ExecResult & execResult, const QSharedPointer<common::AllDrawData> & data);
-	void actionStrReceived(const QString & actionStr);
+	// null on errors
+	void symbolsReceived(const common::SymbolSourcePtr & symbols);
+
+public:
+	// has to be set before the simulator is moved to its thread
+	void setExpansionCache(const QSharedPointer<ExpansionCache> & cache);
 
 public slots:
 	void exec(const QSharedPointer<common::AllDrawData> & data);
@@ -151,16 +175,35 @@ private:
 	bool execOneIteration();
 
 	common::LineSegs getSegments();
-	void composeActionStr();
+	common::SymbolSourcePtr createSymbolSource(quint32 depth) const;
+
+	void execExpansion(const common::ConfigSet & newConfig, bool executedSameExpansion, const common::MetaData & meta, common::ExecResult & res);
+	bool loadCachedExpansion(const common::MetaData & meta, common::ExecResult & res);
+
+	// Out of core: walk the expansion depth-first and spill the segments to a temporary file
+	void execOutOfCore(const common::ConfigSet & newConfig, common::ExecResult & res);
+
+	// Level of detail: descend only into subtrees which are larger than a pixel
+	void execLevelOfDetail(const common::ConfigSet & newConfig, const common::MetaData & meta, common::ExecResult & res);
+	void calcSubtreeGeoms(quint32 maxDepth);
+	bool getSegmentsLod(const common::ConfigSet & newConfig, quint32 depth, common::LineSegs & segs);
+	bool execLodRecursive(const impl::ProcessLiteralAction * action, quint32 depth, impl::State & state, common::LineSegs & segs);
 
 private:
 	bool validConfig = false;
 	common::ConfigSet config;
 	common::LineSegs segments;
-	QString actionStr;
+	common::SegmentSpill * spill = nullptr; // receives the segments instead of `segments` if set
 
 	QList<const impl::Action *> currentActions;
 	QList<const impl::Action *> nextActions;
+	bool expanded = false; // currentActions contain the expansion of config
+
+	QSharedPointer<ExpansionCache> expansionCache;
+	std::optional<quint64> uncachedKey; // set if the last expansion should be stored in the cache
+
+	// per literal, indexed by depth
+	QMap<char, QVector<impl::SubtreeGeom>> subtreeGeoms;
 
 	int maxStackSize = 0;
 	int curMaxStackSize = 0;
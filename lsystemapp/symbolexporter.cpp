@@ -0,0 +1,179 @@
+#include "symbolexporter.h"
+
+#include <QSaveFile>
+#include <QtConcurrent>
+
+#ifdef Q_OS_WIN
+#include <QtZlib/zlib.h>
+#else
+#include <zlib.h>
+#endif
+
+using namespace lsystem::common;
+
+namespace {
+
+constexpr int CompressionLevel = 6;
+
+// Encodes the pages into the output format, runs may continue across pages.
+class SymbolEncoder final
+{
+public:
+	SymbolEncoder(QSaveFile & file, lsystem::SymbolExporter::Format format)
+		: file(file)
+		, format(format)
+	{
+		if (format == lsystem::SymbolExporter::Format::Gzip) {
+			// window bits + 16 writes the gzip header and trailer
+			ok = deflateInit2(&stream, CompressionLevel, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+			compressionFailed = !ok;
+		}
+	}
+
+	~SymbolEncoder()
+	{
+		if (format == lsystem::SymbolExporter::Format::Gzip) deflateEnd(&stream);
+	}
+
+	bool add(const QByteArray & page)
+	{
+		if (format != lsystem::SymbolExporter::Format::RunLength) return write(page, false);
+
+		QByteArray encoded;
+		encoded.reserve(page.size());
+		for (char c : page) {
+			if (c == runSymbol) {
+				++runLength;
+				continue;
+			}
+			appendRun(encoded);
+			runSymbol = c;
+			runLength = 1;
+		}
+		return write(encoded, false);
+	}
+
+	bool finish()
+	{
+		QByteArray rest;
+		appendRun(rest);
+		return write(rest, true);
+	}
+
+	// the file has no error if zlib failed
+	QString errorString() const { return compressionFailed ? "compression failed" : file.errorString(); }
+
+private:
+	void appendRun(QByteArray & out)
+	{
+		if (runLength >= lsystem::SymbolExporter::MinRunLength) {
+			out += runSymbol;
+			out += '{' + QByteArray::number(runLength) + '}';
+		} else {
+			out.append(runLength, runSymbol);
+		}
+		runLength = 0;
+	}
+
+	bool write(const QByteArray & data, bool last)
+	{
+		if (!ok) return false;
+		if (format != lsystem::SymbolExporter::Format::Gzip) return ok = file.write(data) == data.size();
+
+		QByteArray out(qMax<qsizetype>(data.size(), 1 << 16), Qt::Uninitialized);
+		stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+		stream.avail_in = data.size();
+		int result;
+		do {
+			stream.next_out = reinterpret_cast<Bytef *>(out.data());
+			stream.avail_out = out.size();
+			result = deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+			if (result == Z_STREAM_ERROR) {
+				compressionFailed = true;
+				return ok = false;
+			}
+			const qsizetype produced = out.size() - stream.avail_out;
+			if (file.write(out.constData(), produced) != produced) return ok = false;
+		} while (stream.avail_out == 0 || (last && result != Z_STREAM_END));
+		return true;
+	}
+
+private:
+	QSaveFile & file;
+	const lsystem::SymbolExporter::Format format;
+	z_stream stream{};
+	bool ok = true;
+	bool compressionFailed = false;
+	char runSymbol = '\0';
+	quint64 runLength = 0;
+};
+
+} // namespace
+
+namespace lsystem {
+
+SymbolExporter::SymbolExporter()
+{
+	connect(&watcher, &QFutureWatcher<QString>::finished, this, [this]() { emit finished(watcher.result()); });
+}
+
+SymbolExporter::~SymbolExporter()
+{
+	cancel();
+	watcher.waitForFinished();
+}
+
+SymbolExporter::Format SymbolExporter::formatFromFileName(const QString & fileName)
+{
+	if (fileName.endsWith(".gz", Qt::CaseInsensitive)) return Format::Gzip;
+	if (fileName.endsWith(".rle", Qt::CaseInsensitive)) return Format::RunLength;
+	return Format::Plain;
+}
+
+QString SymbolExporter::exportSymbols(const SymbolSource & symbols,
+									  Format format,
+									  const QString & fileName,
+									  const std::function<bool(quint64)> & progress)
+{
+	QSaveFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly)) return file.errorString();
+	SymbolEncoder encoder(file, format);
+
+	const quint64 size = symbols.size();
+	for (quint64 offset = 0; offset < size;) {
+		const QByteArray page = symbols.symbols(offset, PageSize).toLatin1();
+		if (page.isEmpty()) break;
+		if (!encoder.add(page)) return encoder.errorString();
+		offset += page.size();
+		if (progress && !progress(offset)) {
+			file.cancelWriting();
+			return "cancelled";
+		}
+	}
+
+	if (!encoder.finish()) return encoder.errorString();
+	if (!file.commit()) return file.errorString();
+	return QString();
+}
+
+void SymbolExporter::start(const SymbolSourcePtr & symbols, const QString & fileName)
+{
+	if (isActive()) {
+		emit finished("an export is already running");
+		return;
+	}
+	cancelRequested = false;
+	watcher.setFuture(QtConcurrent::run([this, symbols, fileName]() {
+		const quint64 size = symbols->size();
+		int lastPercent = -1;
+		return exportSymbols(*symbols, formatFromFileName(fileName), fileName, [this, size, &lastPercent](quint64 exported) {
+			const int percent = static_cast<int>(static_cast<long double>(exported) / size * 100);
+			if (percent != lastPercent) emit progress(lastPercent = percent);
+			return !cancelRequested;
+		});
+	}));
+}
+
+void SymbolExporter::cancel() { cancelRequested = true; }
+
+} // namespace lsystem
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <common.h>
+
+#include <QFutureWatcher>
+#include <QObject>
+
+#include <atomic>
+#include <functional>
+
+namespace lsystem {
+
+// Writes the symbols of an expansion to a file, page by page from the symbol source, such that the output may be
+// much larger than the memory. The file is only replaced if the export completes.
+class SymbolExporter : public QObject
+{
+	Q_OBJECT
+public:
+	enum class Format
+	{
+		Plain,
+		RunLength, // runs of at least MinRunLength equal symbols are written as the symbol and the count in braces, e.g. "F{12}"
+		Gzip
+	};
+
+	static const constexpr int PageSize = 1 << 20;
+	static const constexpr int MinRunLength = 4;
+
+	SymbolExporter();
+	~SymbolExporter();
+
+	bool isActive() const { return watcher.isRunning(); }
+
+	// by the suffix, i.e., ".gz" and ".rle"
+	static Format formatFromFileName(const QString & fileName);
+
+	// `progress` receives the number of exported symbols after each page, the export stops if it returns false
+	static QString exportSymbols(const common::SymbolSource & symbols,
+								 Format format,
+								 const QString & fileName,
+								 const std::function<bool(quint64)> & progress = {});
+
+public slots:
+	void start(const lsystem::common::SymbolSourcePtr & symbols, const QString & fileName);
+	void cancel();
+
+signals:
+	void progress(int percent);
+	// `errorString` is empty on success
+	void finished(const QString & errorString);
+
+private:
+	QFutureWatcher<QString> watcher;
+	std::atomic_bool cancelRequested = false;
+};
+
+} // namespace lsystem
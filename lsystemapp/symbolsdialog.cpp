@@ -1,40 +1,76 @@
 #include "symbolsdialog.h"
 #include "ui_symbolsdialog.h"
 
+#include <symbolexporter.h>
+
 #include <QClipboard>
+#include <QFileDialog>
+#include <QFontDatabase>
+#include <QMessageBox>
 #include <QResizeEvent>
+#include <QScrollBar>
+#include <QWheelEvent>
+
+namespace {
+
+// The clipboard gets at most this number of symbols, from the first visible symbol on.
+constexpr int MaxCopySymbols = 1 << 24;
+
+// Scroll bar positions, expansions with more rows are mapped proportionally.
+constexpr int MaxScrollValue = 1 << 30;
+
+} // namespace
 
 SymbolsDialog::SymbolsDialog(QWidget * parent)
 	: QDialog(parent)
 	, ui(new Ui::SymbolsDialog)
+	, exporter(new lsystem::SymbolExporter())
 {
 	ui->setupUi(this);
 
+	// fixed width, such that the symbols of a page can be laid out in rows
+	ui->txtSymbols->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+	ui->txtSymbols->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+	ui->txtSymbols->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+	ui->txtSymbols->setLineWrapMode(QTextEdit::NoWrap);
+	ui->txtSymbols->viewport()->installEventFilter(this);
+
 	connect(ui->cmdClose, &QPushButton::clicked, this, &SymbolsDialog::close);
+	connect(ui->cmdCopy, &QPushButton::clicked, this, &SymbolsDialog::onCmdCopyClicked);
+	connect(ui->cmdSave, &QPushButton::clicked, this, &SymbolsDialog::onCmdSaveClicked);
+	connect(exporter.get(), &lsystem::SymbolExporter::progress, this, [this](int percent) {
+		ui->cmdSave->setText(QString("Cancel (%1%)").arg(percent));
+	});
+	connect(exporter.get(), &lsystem::SymbolExporter::finished, this, &SymbolsDialog::exportFinished);
+	connect(ui->scrSymbols, &QScrollBar::valueChanged, this, &SymbolsDialog::onScrollBarValueChanged);
+	connect(ui->scrSymbols, &QScrollBar::actionTriggered, this, &SymbolsDialog::onScrollBarActionTriggered);
+	connect(ui->txtOffset, &QLineEdit::returnPressed, this, &SymbolsDialog::onTxtOffsetReturnPressed);
 }
 
 SymbolsDialog::~SymbolsDialog() { delete ui; }
 
-void SymbolsDialog::setContent(const QString & content)
+void SymbolsDialog::setContent(const lsystem::common::SymbolSourcePtr & content)
 {
-	if (content.isEmpty()) return;
-
-	lastContent = content;
-	ui->cmdCopy->setEnabled(true);
-
-	// inserting zero-width-spaces allows linebreak at every position
-	const QString zeroWidthSpace = "\u200B";
-	QString rv;
-	for (QChar c : content) {
-		rv += c + zeroWidthSpace;
+	if (!content) {
+		clearContent();
+		ui->txtSymbols->setPlainText("(error occurred)");
+		return;
 	}
-	ui->txtSymbols->setText(rv);
+
+	symbols = content;
+	ui->cmdCopy->setEnabled(symbols->size() > 0);
+	ui->cmdSave->setEnabled(symbols->size() > 0 || exporter->isActive());
+	ui->txtOffset->setEnabled(true);
+	updateLayout();
 }
 
 void SymbolsDialog::clearContent()
 {
+	symbols.reset();
 	ui->cmdCopy->setEnabled(false);
-	ui->txtSymbols->clear();
+	ui->cmdSave->setEnabled(exporter->isActive());
+	ui->txtOffset->setEnabled(false);
+	updateLayout();
 }
 
 void SymbolsDialog::resizeEvent(QResizeEvent * event)
@@ -42,16 +78,173 @@ void SymbolsDialog::resizeEvent(QResizeEvent * event)
 	const int border = 10;
 	const int wdt = event->size().width();
 	const int hgt = event->size().height();
+	const int scrollWdt = ui->scrSymbols->sizeHint().width();
 
-	ui->txtSymbols->resize(wdt - 2 * border, hgt - ui->cmdClose->height() - 3 * border);
+	ui->txtSymbols->resize(wdt - 2 * border - scrollWdt, hgt - ui->cmdClose->height() - 3 * border);
 	auto labelGeom = ui->txtSymbols->geometry();
+	ui->scrSymbols->setGeometry(labelGeom.right() + 1, labelGeom.top(), scrollWdt, labelGeom.height());
 	auto buttonsGeom = ui->wdgButtons->geometry();
 	ui->wdgButtons->setGeometry(
-		labelGeom.right() - buttonsGeom.width(), labelGeom.bottom() + border, buttonsGeom.width(), buttonsGeom.height());
+		labelGeom.right() + scrollWdt - buttonsGeom.width(), labelGeom.bottom() + border, buttonsGeom.width(), buttonsGeom.height());
+	auto navigationGeom = ui->wdgNavigation->geometry();
+	ui->wdgNavigation->setGeometry(labelGeom.left(), labelGeom.bottom() + border, navigationGeom.width(), navigationGeom.height());
+
+	updateLayout();
+}
+
+bool SymbolsDialog::eventFilter(QObject * obj, QEvent * event)
+{
+	if (obj == ui->txtSymbols->viewport() && event->type() == QEvent::Wheel) {
+		// the text only contains the visible page, scroll through the expansion instead
+		QWheelEvent * wheelEvent = static_cast<QWheelEvent *>(event);
+		const int rows = wheelEvent->angleDelta().y() / 40;
+		scrollToRow(rows > 0 ? firstRow - qMin<quint64>(firstRow, rows) : firstRow + static_cast<quint64>(-rows));
+		return true;
+	}
+	return QDialog::eventFilter(obj, event);
 }
 
 void SymbolsDialog::onCmdCopyClicked()
 {
+	if (!symbols) return;
 	QClipboard * clipboard = QGuiApplication::clipboard();
-	clipboard->setText(lastContent);
+	clipboard->setText(symbols->symbols(firstRow * symbolsPerRow, MaxCopySymbols));
+}
+
+void SymbolsDialog::onCmdSaveClicked()
+{
+	if (exporter->isActive()) {
+		exportCancelled = true;
+		exporter->cancel();
+		return;
+	}
+	if (!symbols) return;
+
+	const QString fileName = QFileDialog::getSaveFileName(
+		this, "Save symbols", QString(), "Text (*.txt);;Run-length encoded (*.rle);;Gzip compressed (*.gz);;All files (*)");
+	if (fileName.isEmpty()) return;
+	ui->cmdSave->setText("Cancel");
+	exportCancelled = false;
+	exporter->start(symbols, fileName);
+}
+
+void SymbolsDialog::exportFinished(const QString & errorString)
+{
+	ui->cmdSave->setText("Save...");
+	ui->cmdSave->setEnabled(symbols && symbols->size() > 0);
+	if (!errorString.isEmpty() && !exportCancelled) QMessageBox::warning(this, "Save symbols", "Saving the symbols failed: " + errorString);
+}
+
+void SymbolsDialog::onTxtOffsetReturnPressed()
+{
+	bool ok;
+	const quint64 offset = ui->txtOffset->text().toULongLong(&ok);
+	if (ok) scrollToRow(offset / symbolsPerRow);
+}
+
+void SymbolsDialog::onScrollBarValueChanged(int value)
+{
+	// ignore the value set from the current row, a scaled value would not map back to the same row
+	if (value == scrollValue(firstRow)) return;
+
+	const quint64 maxRow = maxFirstRow();
+	if (maxRow <= MaxScrollValue) {
+		firstRow = value;
+	} else {
+		firstRow = static_cast<quint64>(static_cast<long double>(value) / MaxScrollValue * maxRow);
+	}
+	updatePage();
+}
+
+void SymbolsDialog::onScrollBarActionTriggered(int action)
+{
+	// step by rows, also if one scroll bar step covers many rows
+	quint64 row = firstRow;
+	switch (action) {
+		case QAbstractSlider::SliderSingleStepAdd:
+			row += 1;
+			break;
+		case QAbstractSlider::SliderSingleStepSub:
+			row -= qMin<quint64>(row, 1);
+			break;
+		case QAbstractSlider::SliderPageStepAdd:
+			row += visibleRows;
+			break;
+		case QAbstractSlider::SliderPageStepSub:
+			row -= qMin<quint64>(row, visibleRows);
+			break;
+		default:
+			return;
+	}
+	firstRow = qMin(row, maxFirstRow());
+	// the scroll bar applies the slider position after this signal
+	ui->scrSymbols->setSliderPosition(scrollValue(firstRow));
+	updatePage();
+}
+
+void SymbolsDialog::updateLayout()
+{
+	const QFontMetrics metrics(ui->txtSymbols->font());
+	const QRect textRect = ui->txtSymbols->viewport()->rect().adjusted(4, 4, -4, -4);
+	symbolsPerRow = qMax(1, textRect.width() / qMax(1, metrics.horizontalAdvance('A')));
+	visibleRows = qMax(1, textRect.height() / qMax(1, metrics.lineSpacing()));
+
+	const quint64 maxRow = maxFirstRow();
+	firstRow = qMin(firstRow, maxRow);
+	{
+		// a clamped value of the old range must not move the row
+		const QSignalBlocker blocker(ui->scrSymbols);
+		ui->scrSymbols->setRange(0, static_cast<int>(qMin<quint64>(maxRow, MaxScrollValue)));
+		ui->scrSymbols->setPageStep(visibleRows);
+		ui->scrSymbols->setValue(scrollValue(firstRow));
+	}
+	updatePage();
+}
+
+void SymbolsDialog::updatePage()
+{
+	if (!symbols) {
+		ui->txtSymbols->clear();
+		ui->lblPosition->clear();
+		return;
+	}
+
+	const quint64 offset = firstRow * symbolsPerRow;
+	const QString page = symbols->symbols(offset, symbolsPerRow * visibleRows);
+	QString text;
+	text.reserve(page.size() + visibleRows);
+	for (qsizetype pos = 0; pos < page.size(); pos += symbolsPerRow) {
+		if (pos > 0) text += '\n';
+		text += page.mid(pos, symbolsPerRow);
+	}
+	ui->txtSymbols->setPlainText(text);
+	ui->lblPosition->setText(QString("%1 - %2 of %3").arg(offset).arg(offset + page.size()).arg(symbols->size()));
+}
+
+quint64 SymbolsDialog::rowCount() const
+{
+	if (!symbols) return 0;
+	const quint64 size = symbols->size();
+	return size / symbolsPerRow + (size % symbolsPerRow ? 1 : 0);
+}
+
+quint64 SymbolsDialog::maxFirstRow() const
+{
+	const quint64 rows = rowCount();
+	return rows > static_cast<quint64>(visibleRows) ? rows - visibleRows : 0;
+}
+
+int SymbolsDialog::scrollValue(quint64 row) const
+{
+	const quint64 maxRow = maxFirstRow();
+	if (maxRow <= MaxScrollValue) return static_cast<int>(row);
+	return static_cast<int>(static_cast<long double>(row) / maxRow * MaxScrollValue);
+}
+
+void SymbolsDialog::scrollToRow(quint64 row)
+{
+	firstRow = qMin(row, maxFirstRow());
+	// the value changed signal is ignored for the value of the current row
+	ui->scrSymbols->setValue(scrollValue(firstRow));
+	updatePage();
 }
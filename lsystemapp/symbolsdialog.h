@@ -1,11 +1,19 @@
 #pragma once
 
+#include <common.h>
+
 #include <QDialog>
 
+namespace lsystem {
+class SymbolExporter;
+} // namespace lsystem
+
 namespace Ui {
 class SymbolsDialog;
 }
 
+// Shows the symbols of an expansion page by page. Only the visible symbols are composed from the symbol source,
+// so expansions of any size can be inspected. They can be saved to a file in the background.
 class SymbolsDialog : public QDialog
 {
 	Q_OBJECT
@@ -14,17 +22,37 @@ public:
 	explicit SymbolsDialog(QWidget * parent = nullptr);
 	~SymbolsDialog();
 
-	void setContent(const QString & content);
+	void setContent(const lsystem::common::SymbolSourcePtr & content);
 	void clearContent();
 
 protected:
 	void resizeEvent(QResizeEvent * event) override;
+	bool eventFilter(QObject * obj, QEvent * event) override;
 
 private slots:
 	void onCmdCopyClicked();
+	void onCmdSaveClicked();
+	void onTxtOffsetReturnPressed();
+	void onScrollBarValueChanged(int value);
+	void onScrollBarActionTriggered(int action);
 
 private:
-	Ui::SymbolsDialog * const ui;
+	void updateLayout();
+	void updatePage();
+	quint64 rowCount() const;
+	quint64 maxFirstRow() const;
+	int scrollValue(quint64 row) const;
+	void scrollToRow(quint64 row);
+	void exportFinished(const QString & errorString);
 
-	QString lastContent;
+private:
+	Ui::SymbolsDialog * const ui;
+	QScopedPointer<lsystem::SymbolExporter> exporter;
+
+	lsystem::common::SymbolSourcePtr symbols;
+	int symbolsPerRow = 1;
+	int visibleRows = 1;
+	// The scroll bar is derived from this row, it is scaled for expansions with more rows than scroll bar positions.
+	quint64 firstRow = 0;
+	bool exportCancelled = false;
 };
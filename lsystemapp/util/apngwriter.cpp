@@ -0,0 +1,176 @@
+#include "apngwriter.h"
+
+#include <QtEndian>
+
+#include <array>
+
+namespace {
+
+constexpr char PngSignature[] = "\x89PNG\r\n\x1a\n";
+constexpr int PngSignatureSize = 8;
+
+const std::array<quint32, 256> & crcTable()
+{
+	static const std::array<quint32, 256> table = [] {
+		std::array<quint32, 256> rv{};
+		for (quint32 n = 0; n < 256; ++n) {
+			quint32 c = n;
+			for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			rv[n] = c;
+		}
+		return rv;
+	}();
+	return table;
+}
+
+quint32 crc32(const QByteArray & data, quint32 crc = 0xffffffffu)
+{
+	const auto & table = crcTable();
+	for (const char c : data) crc = table[(crc ^ static_cast<quint8>(c)) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+void appendBigEndian32(QByteArray & data, quint32 value)
+{
+	const quint32 be = qToBigEndian(value);
+	data.append(reinterpret_cast<const char *>(&be), sizeof(be));
+}
+
+void appendBigEndian16(QByteArray & data, quint16 value)
+{
+	const quint16 be = qToBigEndian(value);
+	data.append(reinterpret_cast<const char *>(&be), sizeof(be));
+}
+
+struct PngChunk
+{
+	QByteArray type;
+	QByteArray data;
+};
+
+// splits a PNG file into its chunks, returns an empty list if it is malformed
+QList<PngChunk> splitChunks(const QByteArray & png)
+{
+	QList<PngChunk> rv;
+	if (!png.startsWith(QByteArray(PngSignature, PngSignatureSize))) return {};
+	qsizetype pos = PngSignatureSize;
+	while (pos + 12 <= png.size()) {
+		const qsizetype length = qFromBigEndian<quint32>(png.constData() + pos);
+		if (pos + 12 + length > png.size()) return {};
+		rv << PngChunk{.type = png.mid(pos + 4, 4), .data = png.mid(pos + 8, length)};
+		pos += 12 + length;
+	}
+	return rv;
+}
+
+} // namespace
+
+namespace lsystem::ui {
+
+bool ApngWriter::open(const QString & fileName, int newFrameCount, int newFrameDelayMs)
+{
+	frameCount = newFrameCount;
+	frameDelayMs = newFrameDelayMs;
+	framesWritten = 0;
+	sequenceNum = 0;
+	frameSize = QSize();
+	error.clear();
+
+	file.setFileName(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return fail(file.errorString());
+	return true;
+}
+
+bool ApngWriter::addFrame(const QByteArray & png)
+{
+	if (!file.isOpen()) return false;
+
+	const QList<PngChunk> chunks = splitChunks(png);
+	if (chunks.isEmpty() || chunks.first().type != "IHDR" || chunks.first().data.size() < 8) return fail("invalid PNG frame");
+	const QByteArray & ihdr = chunks.first().data;
+	const QSize size(qFromBigEndian<quint32>(ihdr.constData()), qFromBigEndian<quint32>(ihdr.constData() + 4));
+
+	if (framesWritten == 0) {
+		frameSize = size;
+		if (file.write(PngSignature, PngSignatureSize) != PngSignatureSize) return fail(file.errorString());
+		if (!writeChunk("IHDR", ihdr)) return false;
+		QByteArray actl;
+		appendBigEndian32(actl, frameCount);
+		appendBigEndian32(actl, 0); // loop forever
+		if (!writeChunk("acTL", actl)) return false;
+		// ancillary chunks before the image data (e.g. gamma) apply to all frames
+		for (const PngChunk & chunk : chunks) {
+			if (chunk.type == "IDAT") break;
+			if (chunk.type != "IHDR" && !writeChunk(chunk.type.constData(), chunk.data)) return false;
+		}
+	} else if (size != frameSize) {
+		return fail("frames differ in size");
+	}
+
+	QByteArray fctl;
+	appendBigEndian32(fctl, sequenceNum++);
+	appendBigEndian32(fctl, size.width());
+	appendBigEndian32(fctl, size.height());
+	appendBigEndian32(fctl, 0); // x offset
+	appendBigEndian32(fctl, 0); // y offset
+	appendBigEndian16(fctl, frameDelayMs);
+	appendBigEndian16(fctl, 1000);
+	fctl.append(char(0)); // dispose: none
+	fctl.append(char(0)); // blend: source
+	if (!writeChunk("fcTL", fctl)) return false;
+
+	for (const PngChunk & chunk : chunks) {
+		if (chunk.type != "IDAT") continue;
+		if (framesWritten == 0) {
+			if (!writeChunk("IDAT", chunk.data)) return false;
+		} else {
+			QByteArray fdat;
+			appendBigEndian32(fdat, sequenceNum++);
+			fdat.append(chunk.data);
+			if (!writeChunk("fdAT", fdat)) return false;
+		}
+	}
+
+	++framesWritten;
+	return true;
+}
+
+bool ApngWriter::finish()
+{
+	if (!file.isOpen()) return false;
+	if (framesWritten != frameCount) {
+		abort();
+		return fail("incomplete animation");
+	}
+	const bool ok = writeChunk("IEND", QByteArray());
+	file.close();
+	return ok;
+}
+
+void ApngWriter::abort()
+{
+	if (!file.isOpen()) return;
+	file.close();
+	file.remove();
+}
+
+bool ApngWriter::writeChunk(const char * type, const QByteArray & data)
+{
+	QByteArray chunk;
+	chunk.reserve(data.size() + 12);
+	appendBigEndian32(chunk, data.size());
+	chunk.append(type, 4);
+	chunk.append(data);
+	// the CRC covers type and data
+	appendBigEndian32(chunk, crc32(chunk.mid(4)) ^ 0xffffffffu);
+	if (file.write(chunk) != chunk.size()) return fail(file.errorString());
+	return true;
+}
+
+bool ApngWriter::fail(const QString & errorText)
+{
+	if (error.isEmpty()) error = errorText;
+	return false;
+}
+
+} // namespace lsystem::ui
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QFile>
+#include <QSize>
+
+namespace lsystem::ui {
+
+// Writes an animated PNG from PNG encoded frames of equal size. The chunks of every frame are taken over
+// without decoding, only the image data is moved into frame data chunks. The frame count has to be known in advance.
+class ApngWriter final
+{
+public:
+	bool open(const QString & fileName, int frameCount, int frameDelayMs);
+	bool addFrame(const QByteArray & png);
+	// returns false if not all announced frames were added
+	bool finish();
+	void abort();
+
+	QString errorString() const { return error; }
+
+private:
+	bool writeChunk(const char * type, const QByteArray & data);
+	bool fail(const QString & errorText);
+
+private:
+	QFile file;
+	QString error;
+	int frameCount = 0;
+	int frameDelayMs = 0;
+	int framesWritten = 0;
+	quint32 sequenceNum = 0;
+	QSize frameSize;
+};
+
+} // namespace lsystem::ui
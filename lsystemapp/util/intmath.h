@@ -0,0 +1,8 @@
+#pragma once
+
+namespace lsystem::ui {
+
+// integer division rounding towards negative infinity, e.g., for the tile/cell index of negative coordinates
+inline int floorDiv(int val, int divisor) { return val >= 0 ? val / divisor : -((-val + divisor - 1) / divisor); }
+
+} // namespace lsystem::ui
@@ -0,0 +1,154 @@
+#include "pngstreamwriter.h"
+
+#include <QtEndian>
+
+#ifdef Q_OS_WIN
+#include <QtZlib/zlib.h>
+#else
+#include <zlib.h>
+#endif
+
+namespace {
+
+constexpr char PngSignature[] = "\x89PNG\r\n\x1a\n";
+constexpr int PngSignatureSize = 8;
+constexpr int CompressionLevel = 6;
+// the image data is split into chunks of this size
+constexpr qsizetype MaxChunkSize = 1 << 20;
+
+void appendBigEndian32(QByteArray & data, quint32 value)
+{
+	const quint32 be = qToBigEndian(value);
+	data.append(reinterpret_cast<const char *>(&be), sizeof(be));
+}
+
+// PNG scanlines with the "Sub" filter, which only depends on the row itself
+QByteArray toScanlines(const QImage & band)
+{
+	const int width = band.width();
+	QByteArray rv(static_cast<qsizetype>(band.height()) * (1 + 3 * width), Qt::Uninitialized);
+	char * out = rv.data();
+	for (int y = 0; y < band.height(); ++y) {
+		const QRgb * line = reinterpret_cast<const QRgb *>(band.constScanLine(y));
+		*out++ = 1; // filter type Sub
+		quint8 prev[3] = {0, 0, 0};
+		for (int x = 0; x < width; ++x) {
+			const QRgb pixel = line[x];
+			const quint8 rgb[3] = {static_cast<quint8>(qRed(pixel)), static_cast<quint8>(qGreen(pixel)), static_cast<quint8>(qBlue(pixel))};
+			for (int c = 0; c < 3; ++c) {
+				*out++ = static_cast<char>(rgb[c] - prev[c]);
+				prev[c] = rgb[c];
+			}
+		}
+	}
+	return rv;
+}
+
+} // namespace
+
+namespace lsystem::ui {
+
+PngStreamWriter::DeflatedBand PngStreamWriter::deflateBand(const QImage & band, bool lastBand)
+{
+	const QImage image = band.format() == QImage::Format_RGB32 ? band : band.convertToFormat(QImage::Format_RGB32);
+	const QByteArray raw = toScanlines(image);
+
+	DeflatedBand rv;
+	rv.rawSize = raw.size();
+	rv.adler = adler32(1, reinterpret_cast<const Bytef *>(raw.constData()), raw.size());
+
+	z_stream stream{};
+	// raw deflate, the zlib header and checksum are written for the whole image
+	if (deflateInit2(&stream, CompressionLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return rv;
+	rv.data.resize(deflateBound(&stream, raw.size()) + 16);
+	stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(raw.constData()));
+	stream.avail_in = raw.size();
+	stream.next_out = reinterpret_cast<Bytef *>(rv.data.data());
+	stream.avail_out = rv.data.size();
+	// Non-final bands end with a sync flush, which aligns to a byte boundary without ending the stream.
+	const int result = deflate(&stream, lastBand ? Z_FINISH : Z_SYNC_FLUSH);
+	rv.ok = lastBand ? result == Z_STREAM_END : result == Z_OK && stream.avail_in == 0;
+	rv.data.resize(rv.data.size() - stream.avail_out);
+	deflateEnd(&stream);
+	return rv;
+}
+
+bool PngStreamWriter::open(const QString & fileName, const QSize & size)
+{
+	error.clear();
+	adler = 1;
+	headerWritten = false;
+
+	file.setFileName(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return fail(file.errorString());
+	if (file.write(PngSignature, PngSignatureSize) != PngSignatureSize) return fail(file.errorString());
+
+	QByteArray ihdr;
+	appendBigEndian32(ihdr, size.width());
+	appendBigEndian32(ihdr, size.height());
+	ihdr.append(char(8)); // bit depth
+	ihdr.append(char(2)); // color type RGB
+	ihdr.append(char(0)); // compression
+	ihdr.append(char(0)); // filter
+	ihdr.append(char(0)); // no interlace
+	return writeChunk("IHDR", ihdr);
+}
+
+bool PngStreamWriter::addBand(const DeflatedBand & band)
+{
+	if (!file.isOpen()) return false;
+	if (!band.ok) return fail("compression failed");
+
+	QByteArray data;
+	if (!headerWritten) {
+		// zlib header: deflate with 32K window, default compression
+		data.append(char(0x78));
+		data.append(char(0x9c));
+		headerWritten = true;
+	}
+	data.append(band.data);
+	adler = adler32_combine(adler, band.adler, band.rawSize);
+
+	for (qsizetype pos = 0; pos < data.size(); pos += MaxChunkSize) {
+		if (!writeChunk("IDAT", data.mid(pos, MaxChunkSize))) return false;
+	}
+	return true;
+}
+
+bool PngStreamWriter::finish()
+{
+	if (!file.isOpen()) return false;
+	QByteArray checksum;
+	appendBigEndian32(checksum, adler);
+	const bool ok = writeChunk("IDAT", checksum) && writeChunk("IEND", QByteArray());
+	file.close();
+	return ok;
+}
+
+void PngStreamWriter::abort()
+{
+	if (!file.isOpen()) return;
+	file.close();
+	file.remove();
+}
+
+bool PngStreamWriter::writeChunk(const char * type, const QByteArray & data)
+{
+	QByteArray chunk;
+	chunk.reserve(data.size() + 12);
+	appendBigEndian32(chunk, data.size());
+	chunk.append(type, 4);
+	chunk.append(data);
+	// the CRC covers type and data
+	appendBigEndian32(chunk, crc32(0, reinterpret_cast<const Bytef *>(chunk.constData() + 4), chunk.size() - 4));
+	if (file.write(chunk) != chunk.size()) return fail(file.errorString());
+	return true;
+}
+
+bool PngStreamWriter::fail(const QString & errorText)
+{
+	if (error.isEmpty()) error = errorText;
+	return false;
+}
+
+} // namespace lsystem::ui
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <QFile>
+#include <QImage>
+
+namespace lsystem::ui {
+
+// Writes a PNG (8 bit RGB) band by band, such that the whole image never has to be in memory.
+// The bands are compressed independently (e.g., in parallel) to raw deflate data ending on a byte boundary,
+// their concatenation forms the zlib stream of the image data, with the checksums combined.
+class PngStreamWriter final
+{
+public:
+	struct DeflatedBand
+	{
+		QByteArray data;
+		quint32 adler = 0;
+		qint64 rawSize = 0;
+		bool ok = false;
+	};
+
+	static DeflatedBand deflateBand(const QImage & band, bool lastBand);
+
+	bool open(const QString & fileName, const QSize & size);
+	// the bands have to be added from top to bottom, the last one with `lastBand` set
+	bool addBand(const DeflatedBand & band);
+	bool finish();
+	void abort();
+
+	QString errorString() const { return error; }
+
+private:
+	bool writeChunk(const char * type, const QByteArray & data);
+	bool fail(const QString & errorText);
+
+private:
+	QFile file;
+	QString error;
+	quint32 adler = 1;
+	bool headerWritten = false;
+};
+
+} // namespace lsystem::ui
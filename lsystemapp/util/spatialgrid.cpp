@@ -0,0 +1,61 @@
+#include "spatialgrid.h"
+
+#include "intmath.h"
+
+namespace lsystem::ui {
+
+void SpatialGrid::insert(qint64 id, const QRect & rect)
+{
+	remove(id);
+	if (rect.isEmpty()) return;
+
+	itemRects.insert(id, rect);
+	const QRect range = cellRange(rect);
+	for (int cy = range.top(); cy <= range.bottom(); ++cy) {
+		for (int cx = range.left(); cx <= range.right(); ++cx) {
+			cells[QPoint(cx, cy)] << id;
+		}
+	}
+}
+
+void SpatialGrid::remove(qint64 id)
+{
+	const auto it = itemRects.constFind(id);
+	if (it == itemRects.cend()) return;
+
+	const QRect range = cellRange(it.value());
+	for (int cy = range.top(); cy <= range.bottom(); ++cy) {
+		for (int cx = range.left(); cx <= range.right(); ++cx) {
+			const auto cell = cells.find(QPoint(cx, cy));
+			if (cell == cells.end()) continue;
+			cell->removeOne(id);
+			if (cell->isEmpty()) cells.erase(cell);
+		}
+	}
+	itemRects.erase(it);
+}
+
+void SpatialGrid::clear()
+{
+	cells.clear();
+	itemRects.clear();
+}
+
+QVector<qint64> SpatialGrid::itemsAt(const QPoint & pos) const
+{
+	QVector<qint64> rv;
+	const auto cell = cells.constFind(QPoint(floorDiv(pos.x(), CellSize), floorDiv(pos.y(), CellSize)));
+	if (cell == cells.cend()) return rv;
+	for (qint64 id : *cell) {
+		if (itemRects[id].contains(pos)) rv << id;
+	}
+	return rv;
+}
+
+QRect SpatialGrid::cellRange(const QRect & rect)
+{
+	return QRect(QPoint(floorDiv(rect.left(), CellSize), floorDiv(rect.top(), CellSize)),
+				 QPoint(floorDiv(rect.right(), CellSize), floorDiv(rect.bottom(), CellSize)));
+}
+
+} // namespace lsystem::ui
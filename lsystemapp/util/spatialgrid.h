@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QHash>
+#include <QPoint>
+#include <QRect>
+#include <QVector>
+
+namespace lsystem::ui {
+
+// Uniform grid over the bounding rectangles of items (e.g., drawings on the canvas),
+// to find the items at a position without scanning all of them.
+class SpatialGrid final
+{
+public:
+	static const constexpr int CellSize = 256;
+
+	// inserts or updates the rectangle of an item
+	void insert(qint64 id, const QRect & rect);
+	void remove(qint64 id);
+	void clear();
+
+	// items whose rectangle contains `pos`, in no particular order
+	QVector<qint64> itemsAt(const QPoint & pos) const;
+
+private:
+	static QRect cellRange(const QRect & rect);
+
+private:
+	QHash<QPoint, QVector<qint64>> cells;
+	QHash<qint64, QRect> itemRects;
+};
+
+} // namespace lsystem::ui
@@ -0,0 +1,181 @@
+#include "tiledimage.h"
+
+#include "intmath.h"
+
+#include <QtMath>
+
+namespace {
+
+bool lineTouchesRect(const QLineF & line, const QRectF & rect)
+{
+	if (rect.contains(line.p1()) || rect.contains(line.p2())) return true;
+	const QLineF edges[] = {QLineF(rect.topLeft(), rect.topRight()),
+							QLineF(rect.topRight(), rect.bottomRight()),
+							QLineF(rect.bottomRight(), rect.bottomLeft()),
+							QLineF(rect.bottomLeft(), rect.topLeft())};
+	for (const QLineF & edge : edges) {
+		if (line.intersects(edge) == QLineF::BoundedIntersection) return true;
+	}
+	return false;
+}
+
+} // namespace
+
+namespace lsystem::ui {
+
+TiledImage::TiledImage(const QSize & size)
+	: imageSize(size)
+{}
+
+QImage & TiledImage::tile(const QPoint & tileIndex)
+{
+	auto it = tileMap.find(tileIndex);
+	if (it == tileMap.end()) {
+		QImage newTile(TileSize, TileSize, TileFormat);
+		newTile.fill(Qt::transparent);
+		it = tileMap.insert(tileIndex, newTile);
+	}
+	return it.value();
+}
+
+QRgb TiledImage::pixel(const QPoint & pos) const
+{
+	const QPoint tileIndex(floorDiv(pos.x(), TileSize), floorDiv(pos.y(), TileSize));
+	const auto it = tileMap.constFind(tileIndex);
+	if (it == tileMap.cend()) return qRgba(0, 0, 0, 0);
+	return it->pixel(pos - tileIndex * TileSize);
+}
+
+void TiledImage::drawTo(QPainter & painter, const QPoint & pos) const
+{
+	for (auto it = tileMap.cbegin(); it != tileMap.cend(); ++it) {
+		painter.drawImage(pos + it.key() * TileSize, it.value());
+	}
+}
+
+void TiledImage::drawTo(QPainter & painter, const QPoint & pos, const QRect & clipRect) const
+{
+	const QRect range = tileIndexRange(clipRect.translated(-pos));
+	if (range.width() * range.height() < tileMap.size()) {
+		// few tiles within the clip rect, look them up
+		for (int ty = range.top(); ty <= range.bottom(); ++ty) {
+			for (int tx = range.left(); tx <= range.right(); ++tx) {
+				const auto it = tileMap.constFind(QPoint(tx, ty));
+				if (it != tileMap.cend()) painter.drawImage(pos + it.key() * TileSize, it.value());
+			}
+		}
+	} else {
+		for (auto it = tileMap.cbegin(); it != tileMap.cend(); ++it) {
+			if (range.contains(it.key())) painter.drawImage(pos + it.key() * TileSize, it.value());
+		}
+	}
+}
+
+QImage TiledImage::toImage() const
+{
+	QImage rv(imageSize, TileFormat);
+	rv.fill(Qt::transparent);
+	QPainter painter(&rv);
+	drawTo(painter, QPoint(0, 0));
+	return rv;
+}
+
+qint64 TiledImage::memoryUsage() const
+{
+	qint64 rv = 0;
+	for (const QImage & img : tileMap) rv += img.sizeInBytes();
+	return rv;
+}
+
+QRect TiledImage::tileRect(const QPoint & tileIndex) { return QRect(tileIndex * TileSize, QSize(TileSize, TileSize)); }
+
+QRect TiledImage::tileIndexRange(const QRect & rect)
+{
+	if (rect.isEmpty()) return QRect();
+	return QRect(QPoint(floorDiv(rect.left(), TileSize), floorDiv(rect.top(), TileSize)),
+				 QPoint(floorDiv(rect.right(), TileSize), floorDiv(rect.bottom(), TileSize)));
+}
+
+// ----------------------------------------------------------
+
+TiledPainter::TiledPainter(TiledImage & image)
+	: image(image)
+{}
+
+TiledPainter::~TiledPainter()
+{
+	for (auto it = paintSlots.begin(); it != paintSlots.end(); ++it) {
+		it->painter->end();
+		delete it->painter;
+		image.tileMap.insert(it.key(), std::move(*it->image));
+		delete it->image;
+	}
+}
+
+void TiledPainter::setRenderHint(QPainter::RenderHint hint, bool on)
+{
+	renderHints.setFlag(hint, on);
+	for (const PaintSlot & slot : std::as_const(paintSlots)) slot.painter->setRenderHint(hint, on);
+}
+
+void TiledPainter::setPen(const QPen & newPen)
+{
+	pen = newPen;
+	for (const PaintSlot & slot : std::as_const(paintSlots)) slot.painter->setPen(pen);
+}
+
+void TiledPainter::drawLine(const QLine & line)
+{
+	const int margin = penMargin();
+	const QRect bounds = QRect(line.p1(), line.p2()).normalized().adjusted(-margin, -margin, margin, margin);
+	const QRect range = TiledImage::tileIndexRange(bounds);
+
+	if (range.width() == 1 && range.height() == 1) {
+		painterFor(range.topLeft())->drawLine(line);
+		return;
+	}
+
+	// Long lines: skip tiles within the bounding box which are not touched by the line.
+	for (int ty = range.top(); ty <= range.bottom(); ++ty) {
+		for (int tx = range.left(); tx <= range.right(); ++tx) {
+			const QPoint tileIndex(tx, ty);
+			const QRectF tileBounds = QRectF(TiledImage::tileRect(tileIndex)).adjusted(-margin, -margin, margin, margin);
+			if (lineTouchesRect(QLineF(line), tileBounds)) painterFor(tileIndex)->drawLine(line);
+		}
+	}
+}
+
+void TiledPainter::drawPoint(const QPointF & point)
+{
+	const int margin = penMargin();
+	const QRect bounds = QRect(point.toPoint(), QSize(1, 1)).adjusted(-margin, -margin, margin, margin);
+	const QRect range = TiledImage::tileIndexRange(bounds);
+	for (int ty = range.top(); ty <= range.bottom(); ++ty) {
+		for (int tx = range.left(); tx <= range.right(); ++tx) {
+			painterFor(QPoint(tx, ty))->drawPoint(point);
+		}
+	}
+}
+
+QPainter * TiledPainter::painterFor(const QPoint & tileIndex)
+{
+	auto it = paintSlots.find(tileIndex);
+	if (it != paintSlots.end()) return it->painter;
+
+	PaintSlot slot;
+	slot.image = new QImage(image.tileMap.take(tileIndex));
+	if (slot.image->isNull()) {
+		*slot.image = QImage(TiledImage::TileSize, TiledImage::TileSize, TiledImage::TileFormat);
+		slot.image->fill(Qt::transparent);
+	}
+	slot.painter = new QPainter(slot.image);
+	slot.painter->setRenderHints(renderHints);
+	slot.painter->setPen(pen);
+	slot.painter->translate(-tileIndex * TiledImage::TileSize);
+	paintSlots.insert(tileIndex, slot);
+	return slot.painter;
+}
+
+int TiledPainter::penMargin() const { return qCeil(pen.widthF() / 2.) + 1; }
+
+} // namespace lsystem::ui
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QHash>
+#include <QImage>
+#include <QPainter>
+
+namespace lsystem::ui {
+
+// Sparse image built from square tiles. Tiles are only allocated where something is painted,
+// untouched tiles are fully transparent. Tile indices may be negative.
+class TiledImage final
+{
+public:
+	static const constexpr int TileSize = 256;
+	static const constexpr QImage::Format TileFormat = QImage::Format_ARGB32_Premultiplied;
+
+	TiledImage() = default;
+	explicit TiledImage(const QSize & size);
+
+	QSize size() const { return imageSize; }
+	bool isNull() const { return imageSize.isEmpty(); }
+	void clear() { tileMap.clear(); }
+
+	const QHash<QPoint, QImage> & tiles() const { return tileMap; }
+	QImage & tile(const QPoint & tileIndex);
+	void setTile(const QPoint & tileIndex, const QImage & tile) { tileMap.insert(tileIndex, tile); }
+	bool hasTile(const QPoint & tileIndex) const { return tileMap.contains(tileIndex); }
+	void removeTile(const QPoint & tileIndex) { tileMap.remove(tileIndex); }
+	QRgb pixel(const QPoint & pos) const;
+
+	// draws all tiles (or only those intersecting `clipRect`, given in the coordinates of `painter`)
+	void drawTo(QPainter & painter, const QPoint & pos) const;
+	void drawTo(QPainter & painter, const QPoint & pos, const QRect & clipRect) const;
+
+	// dense copy, only for small images (e.g., clipboard export)
+	QImage toImage() const;
+	qint64 memoryUsage() const;
+
+	static QRect tileRect(const QPoint & tileIndex);
+	static QRect tileIndexRange(const QRect & rect);
+
+private:
+	friend class TiledPainter;
+
+	QSize imageSize;
+	QHash<QPoint, QImage> tileMap;
+};
+
+// Painter on a TiledImage. Every primitive is dispatched to the tiles it touches, which are allocated on demand.
+// The tiles are taken out of the image while painting and put back when the painter is destroyed.
+class TiledPainter final
+{
+public:
+	explicit TiledPainter(TiledImage & image);
+	~TiledPainter();
+
+	void setRenderHint(QPainter::RenderHint hint, bool on = true);
+	void setPen(const QPen & newPen);
+
+	void drawLine(const QLine & line);
+	void drawPoint(const QPointF & point);
+
+private:
+	struct PaintSlot
+	{
+		QImage * image = nullptr;
+		QPainter * painter = nullptr;
+	};
+
+	QPainter * painterFor(const QPoint & tileIndex);
+	int penMargin() const;
+
+private:
+	TiledImage & image;
+	QHash<QPoint, PaintSlot> paintSlots;
+	QPen pen;
+	QPainter::RenderHints renderHints;
+};
+
+} // namespace lsystem::ui
@@ -0,0 +1,175 @@
+#include "vectorexporter.h"
+
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QPdfWriter>
+#include <QtConcurrent>
+
+using namespace lsystem::common;
+
+namespace {
+
+// PDF viewers do not support larger pages (200 inch), larger canvases are scaled down
+constexpr double MaxPdfPageSize = 14400;
+
+// Buffered writer, the file is written whenever the buffer is full.
+class StreamWriter final
+{
+public:
+	explicit StreamWriter(QFile & file)
+		: file(file)
+	{
+		buffer.reserve(lsystem::VectorExporter::BufferSize + 1024);
+	}
+
+	StreamWriter & operator<<(const QByteArray & data)
+	{
+		buffer += data;
+		if (buffer.size() >= lsystem::VectorExporter::BufferSize) flush();
+		return *this;
+	}
+
+	StreamWriter & operator<<(const char * data) { return *this << QByteArray::fromRawData(data, qstrlen(data)); }
+	StreamWriter & operator<<(double value) { return *this << QByteArray::number(value, 'g', 8); }
+
+	bool flush()
+	{
+		if (ok && file.write(buffer) != buffer.size()) ok = false;
+		buffer.clear();
+		return ok;
+	}
+
+private:
+	QFile & file;
+	QByteArray buffer;
+	bool ok = true;
+};
+
+QByteArray svgColor(QRgb color) { return QColor(color).name(QColor::HexRgb).toLatin1(); }
+
+QString exportSvg(const QList<lsystem::VectorExportItem> & items, const QColor & backColor, const QRect & rect, const QString & fileName)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return file.errorString();
+	StreamWriter out(file);
+
+	out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+		<< "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << rect.width() << "\" height=\"" << rect.height() << "\" viewBox=\"0 0 "
+		<< rect.width() << " " << rect.height() << "\">\n"
+		<< "<rect width=\"100%\" height=\"100%\" fill=\"" << svgColor(backColor.rgb()) << "\"/>\n";
+
+	for (const lsystem::VectorExportItem & item : items) {
+		const lsystem::ui::Drawing & drawing = *item.drawing;
+		if (drawing.mainMeta.densityMode) {
+			QByteArray png;
+			QBuffer buffer(&png);
+			buffer.open(QIODevice::WriteOnly);
+			item.densityImage.toImage().save(&buffer, "PNG");
+			const QPoint pos = item.canvasRect.topLeft() - rect.topLeft();
+			out << "<image x=\"" << pos.x() << "\" y=\"" << pos.y() << "\" width=\"" << item.densityImage.size().width() << "\" height=\""
+				<< item.densityImage.size().height() << "\" href=\"data:image/png;base64," << png.toBase64() << "\"/>\n";
+			continue;
+		}
+
+		const QPoint translation = item.offset - rect.topLeft();
+		out << "<g transform=\"translate(" << translation.x() << " " << translation.y()
+			<< ")\" fill=\"none\" stroke-linecap=\"round\" stroke-linejoin=\"round\" stroke-width=\"" << drawing.mainMeta.thickness << "\""
+			<< (drawing.mainMeta.antiAliasing ? "" : " shape-rendering=\"crispEdges\"") << ">\n";
+		const auto writePolyline = [&out](QRgb color, const QPolygonF & polyline) {
+			out << "<polyline stroke=\"" << svgColor(color) << "\"";
+			if (qAlpha(color) != 255) out << " stroke-opacity=\"" << qAlpha(color) / 255. << "\"";
+			out << " points=\"";
+			for (const QPointF & point : polyline) out << point.x() << "," << point.y() << " ";
+			out << "\"/>\n";
+		};
+		drawing.forEachPolyline(true, lsystem::VectorExporter::MaxPolylinePoints, writePolyline);
+		drawing.forEachPolyline(false, lsystem::VectorExporter::MaxPolylinePoints, writePolyline);
+		out << "</g>\n";
+	}
+
+	out << "</svg>\n";
+	if (!out.flush()) return file.errorString();
+	return QString();
+}
+
+QString exportPdf(const QList<lsystem::VectorExportItem> & items, const QColor & backColor, const QRect & rect, const QString & fileName)
+{
+	// 1 unit = 1 point. Qt moves the page content to a temporary file if it gets large.
+	const double scale = qMin(1., MaxPdfPageSize / qMax(rect.width(), rect.height()));
+	QPdfWriter writer(fileName);
+	writer.setCreator("lsystem");
+	writer.setResolution(72);
+	writer.setPageSize(QPageSize(QSizeF(rect.size()) * scale, QPageSize::Point));
+	writer.setPageMargins(QMarginsF(0, 0, 0, 0));
+
+	QPainter painter;
+	if (!painter.begin(&writer)) return QString("could not write %1").arg(fileName);
+	painter.scale(scale, scale);
+	painter.fillRect(QRect(QPoint(0, 0), rect.size()), backColor);
+	painter.translate(-rect.topLeft());
+
+	for (const lsystem::VectorExportItem & item : items) {
+		const lsystem::ui::Drawing & drawing = *item.drawing;
+		if (drawing.mainMeta.densityMode) {
+			item.densityImage.drawTo(painter, item.canvasRect.topLeft());
+			continue;
+		}
+
+		painter.save();
+		painter.translate(item.offset);
+		painter.setRenderHint(QPainter::Antialiasing, drawing.mainMeta.antiAliasing);
+		QPen pen;
+		pen.setWidthF(drawing.mainMeta.thickness);
+		pen.setCapStyle(Qt::RoundCap);
+		pen.setJoinStyle(Qt::RoundJoin);
+		const auto drawPolyline = [&painter, &pen](QRgb color, const QPolygonF & polyline) {
+			pen.setColor(QColor::fromRgba(color));
+			painter.setPen(pen);
+			painter.drawPolyline(polyline);
+		};
+		drawing.forEachPolyline(true, lsystem::VectorExporter::MaxPolylinePoints, drawPolyline);
+		drawing.forEachPolyline(false, lsystem::VectorExporter::MaxPolylinePoints, drawPolyline);
+		painter.restore();
+	}
+
+	if (!painter.end()) return QString("could not write %1").arg(fileName);
+	return QString();
+}
+
+} // namespace
+
+namespace lsystem {
+
+VectorExporter::VectorExporter()
+{
+	connect(&watcher, &QFutureWatcher<QString>::finished, this, [this]() {
+		emit finished(watcher.result(), QFileInfo(currentFileName).size(), timer.elapsed());
+	});
+}
+
+VectorExporter::~VectorExporter() { watcher.waitForFinished(); }
+
+void VectorExporter::start(const QList<VectorExportItem> & items, const QColor & backColor, const QString & fileName)
+{
+	if (isActive()) {
+		emit finished("an export is already running", 0, 0);
+		return;
+	}
+
+	QRect rect;
+	for (const VectorExportItem & item : items) rect |= item.canvasRect;
+	if (rect.isEmpty()) {
+		emit finished("nothing to export", 0, 0);
+		return;
+	}
+
+	currentFileName = fileName;
+	timer.start();
+	const bool pdf = fileName.endsWith(".pdf", Qt::CaseInsensitive);
+	watcher.setFuture(QtConcurrent::run([items, backColor, rect, fileName, pdf]() {
+		return pdf ? exportPdf(items, backColor, rect, fileName) : exportSvg(items, backColor, rect, fileName);
+	}));
+}
+
+} // namespace lsystem
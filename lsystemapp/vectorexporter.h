@@ -0,0 +1,47 @@
+#pragma once
+
+#include <drawing.h>
+
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QObject>
+
+namespace lsystem {
+
+struct VectorExportItem final
+{
+	QSharedPointer<ui::Drawing> drawing;
+	// captured when the export starts, the drawing may be moved meanwhile
+	QPoint offset;
+	QRect canvasRect;
+	ui::TiledImage densityImage; // only for density drawings, which have no vector representation
+};
+
+// Exports drawings to SVG or PDF (by the file suffix) in a worker thread. The segments are streamed to the file
+// as polylines instead of building a document, connected segments of the same color are merged.
+class VectorExporter : public QObject
+{
+	Q_OBJECT
+public:
+	static const constexpr qsizetype BufferSize = 1 << 20;
+	static const constexpr int MaxPolylinePoints = 4096;
+
+	VectorExporter();
+	~VectorExporter();
+
+	bool isActive() const { return watcher.isRunning(); }
+
+public slots:
+	void start(const QList<lsystem::VectorExportItem> & items, const QColor & backColor, const QString & fileName);
+
+signals:
+	// `errorString` is empty on success
+	void finished(const QString & errorString, qint64 bytes, qint64 elapsedMs);
+
+private:
+	QFutureWatcher<QString> watcher;
+	QString currentFileName;
+	QElapsedTimer timer;
+};
+
+} // namespace lsystem
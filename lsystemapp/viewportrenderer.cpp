@@ -0,0 +1,126 @@
+#include "viewportrenderer.h"
+
+#include <QElapsedTimer>
+#include <QPainter>
+
+namespace {
+
+// Leaves room within a 60 fps frame for event processing and painting the widget.
+constexpr int StepBudgetMs = 12;
+
+} // namespace
+
+namespace lsystem::ui {
+
+ViewportRenderer::ViewportRenderer()
+{
+	stepTimer.setSingleShot(true);
+	stepTimer.setInterval(0);
+	connect(&stepTimer, &QTimer::timeout, this, &ViewportRenderer::renderStep);
+}
+
+void ViewportRenderer::start(const QList<QSharedPointer<Drawing>> & drawings,
+							 const QSize & viewSize,
+							 const QTransform & canvasToView,
+							 const QColor & backColor)
+{
+	pendingTransform = canvasToView;
+	this->backColor = backColor;
+	deferredRect = QRect();
+	deferredDrawings.clear();
+
+	pendingImage = QImage(viewSize, QImage::Format_RGB32);
+	pendingImage.fill(backColor);
+	begin(drawings, pendingImage.rect());
+}
+
+void ViewportRenderer::update(const QList<QSharedPointer<Drawing>> & drawings,
+							  const QRect & viewRect,
+							  const QSize & viewSize,
+							  const QTransform & canvasToView,
+							  const QColor & backColor)
+{
+	if (active && pendingTransform == canvasToView && this->backColor == backColor) {
+		deferredRect |= viewRect;
+		deferredDrawings = drawings;
+		return;
+	}
+	if (active || image.isNull() || image.size() != viewSize || transform != canvasToView || this->backColor != backColor) {
+		start(drawings, viewSize, canvasToView, backColor);
+		return;
+	}
+
+	// the last image is shown until the area is rendered
+	pendingTransform = canvasToView;
+	pendingImage = image;
+	const QRect rect = viewRect.intersected(pendingImage.rect());
+	QPainter(&pendingImage).fillRect(rect, backColor);
+	begin(drawings, rect);
+}
+
+void ViewportRenderer::begin(const QList<QSharedPointer<Drawing>> & drawings, const QRect & viewRect)
+{
+	pendingDrawings = drawings;
+	renderRect = viewRect;
+	clipRect = pendingTransform.inverted().mapRect(QRectF(viewRect));
+	curDrawing = 0;
+	curChunk = 0;
+
+	active = true;
+	stepTimer.start();
+}
+
+void ViewportRenderer::cancel()
+{
+	stepTimer.stop();
+	active = false;
+	pendingDrawings.clear();
+	pendingImage = QImage();
+	image = QImage();
+	deferredRect = QRect();
+	deferredDrawings.clear();
+}
+
+void ViewportRenderer::renderStep()
+{
+	QElapsedTimer elapsed;
+	elapsed.start();
+
+	QPainter painter(&pendingImage);
+	painter.setClipRect(renderRect);
+	painter.setTransform(pendingTransform);
+
+	while (curDrawing < pendingDrawings.size()) {
+		const Drawing & drawing = *pendingDrawings[curDrawing];
+		if (curChunk >= drawing.vectorChunkCount() || (curChunk == 0 && !clipRect.intersects(QRectF(drawing.canvasRect())))) {
+			++curDrawing;
+			curChunk = 0;
+			continue;
+		}
+
+		drawing.paintVectorChunk(painter, curChunk++, clipRect);
+
+		if (elapsed.elapsed() >= StepBudgetMs) {
+			stepTimer.start();
+			return;
+		}
+	}
+
+	painter.end();
+	image = pendingImage;
+	transform = pendingTransform;
+	pendingImage = QImage();
+	pendingDrawings.clear();
+	active = false;
+
+	if (!deferredRect.isEmpty()) {
+		const QList<QSharedPointer<Drawing>> drawings = deferredDrawings;
+		const QRect rect = deferredRect;
+		deferredRect = QRect();
+		deferredDrawings.clear();
+		update(drawings, rect, image.size(), transform, backColor);
+	}
+	emit renderingFinished();
+}
+
+} // namespace lsystem::ui
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <drawing.h>
+
+#include <QImage>
+#include <QObject>
+#include <QTimer>
+#include <QTransform>
+
+namespace lsystem::ui {
+
+// Renders the visible part of the canvas from the segments instead of scaling the drawing images,
+// such that zoomed views stay sharp. Drawings and segment chunks outside of the view are culled.
+// The work is done in steps of limited duration, such that the UI stays responsive for huge drawings.
+class ViewportRenderer final : public QObject
+{
+	Q_OBJECT
+public:
+	ViewportRenderer();
+
+	void start(const QList<QSharedPointer<Drawing>> & drawings,
+			   const QSize & viewSize,
+			   const QTransform & canvasToView,
+			   const QColor & backColor);
+	// Renders only `viewRect` of the last image again, e.g., after an animation step. If a rendering with the same
+	// transform is running, the area is rendered after it, without a last image for the transform it starts anew.
+	void update(const QList<QSharedPointer<Drawing>> & drawings,
+				const QRect & viewRect,
+				const QSize & viewSize,
+				const QTransform & canvasToView,
+				const QColor & backColor);
+	void cancel();
+
+	bool isActive() const { return active; }
+	// the last image stays valid apart from the area which is rendered again
+	bool isPartial() const { return active && renderRect != pendingImage.rect(); }
+
+	// last completely rendered image with the transform it was rendered for
+	const QImage & getImage() const { return image; }
+	const QTransform & getTransform() const { return transform; }
+
+signals:
+	void renderingFinished();
+
+private:
+	void begin(const QList<QSharedPointer<Drawing>> & drawings, const QRect & viewRect);
+	void renderStep();
+
+private:
+	QTimer stepTimer;
+	bool active = false;
+
+	QList<QSharedPointer<Drawing>> pendingDrawings;
+	QImage pendingImage;
+	QTransform pendingTransform;
+	QRect renderRect; // in view coordinates
+	QRectF clipRect;  // the same in canvas coordinates
+	QColor backColor;
+	int curDrawing = 0;
+	int curChunk = 0;
+
+	QImage image;
+	QTransform transform;
+
+	// changed while rendering, rendered afterwards
+	QRect deferredRect;
+	QList<QSharedPointer<Drawing>> deferredDrawings;
+};
+
+} // namespace lsystem::ui
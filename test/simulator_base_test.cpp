@@ -1,5 +1,10 @@
+#include <QStandardPaths>
+#include <QTemporaryDir>
 #include <QtTest>
 
+#include <configfilestore.h>
+#include <expansioncache.h>
+#include <jsonkeys.h>
 #include <simulator.h>
 
 #include <qsigwatcher/qsigwatcher.h>
@@ -7,6 +12,7 @@
 #include <util/test/utils.h>
 
 using namespace lsystem::common;
+using namespace lsystem::constants;
 using namespace lsystem;
 using namespace sigwatcher;
 using namespace util::test;
@@ -25,6 +31,8 @@ class SimulatorBaseTest : public QObject, public SignalWatcherInterface
 public:
 	SimulatorBaseTest()
 	{
+		// the segment spill files are written to the cache location, not to the one of the user
+		QStandardPaths::setTestModeEnabled(true);
 		lsystem::common::registerCommonTypes();
 	}
 
@@ -56,7 +64,7 @@ private:
 void SimulatorBaseTest::baseTest()
 {
 	SIG_WATCHER(recResult, &simulator, &Simulator::segmentsReceived);
-	SIG_WATCHER(recActionStr, &simulator, &Simulator::actionStrReceived);
+	SIG_WATCHER(recSymbols, &simulator, &Simulator::symbolsReceived);
 	SIG_WATCHER(recErrorStr, &simulator, &Simulator::errorReceived);
 
 	// Base data
@@ -130,7 +138,12 @@ void SimulatorBaseTest::baseTest()
 				   CHECK_RETURN
 			   }))
 
-	SIG_EXPECT(recActionStr, VALUES("A[A]"))
+	SIG_EXPECT(recSymbols, CHECK([](const SymbolSourcePtr & symbols) {
+				   CHECK_VERIFY(symbols);
+				   CHECK_COMPARE(symbols->size(), 4ull);
+				   CHECK_COMPARE(symbols->symbols(0, 4), "A[A]");
+				   CHECK_RETURN
+			   }))
 
 	auto & configSet = inputData->config;
 	configSet.definitions = {Definition('A', "A[A]")};
@@ -152,7 +165,16 @@ void SimulatorBaseTest::baseTest()
 							  CHECK_RETURN
 						  }))
 
-	SIG_EXPECT(recActionStr, VALUES("A+A+A+A"))
+	SIG_EXPECT(recSymbols, CHECK([](const SymbolSourcePtr & symbols) {
+				   CHECK_VERIFY(symbols);
+				   CHECK_COMPARE(symbols->size(), 7ull);
+				   CHECK_COMPARE(symbols->symbols(0, 100), "A+A+A+A");
+				   // windows of the expansion
+				   CHECK_COMPARE(symbols->symbols(2, 3), "A+A");
+				   CHECK_COMPARE(symbols->symbols(5, 10), "+A");
+				   CHECK_COMPARE(symbols->symbols(7, 1), "");
+				   CHECK_RETURN
+			   }))
 
 	configSet.definitions = {Definition('A', "A+A")};
 	configSet.turn.left = 90;
@@ -206,6 +228,159 @@ void SimulatorBaseTest::baseTest()
 	emit exec(inputData);
 
 	SIG_CHECK
+
+	// * Test: level of detail, subtrees larger than a pixel are expanded as usual
+
+	inputData->meta.levelOfDetail = true;
+	configSet.overrideStackSize = {};
+	configSet.definitions = {Definition('A', "A+A")};
+	configSet.turn.left = 90;
+	configSet.startAngle = -90;
+	configSet.numIter = 2;
+	configSet.stepSize = 1;
+
+	SIG_EXPECT(recResult, CHECK_AT(1, [](const ExecResult & res) {
+				   CHECK_COMPARE(res.resultKind, ExecResult::ExecResultKind::Ok);
+				   CHECK_COMPARE(print(res.segments),
+								 "(L((0, 0), (0, -1)), L((0, -1), (1, -1)), L((1, -1), (1, 0)), L((1, 0), (0, 0)))");
+				   CHECK_RETURN
+			   }))
+
+	emit exec(inputData);
+
+	SIG_CHECK
+
+	// * Test: level of detail, the whole (closed) square is smaller than a pixel
+
+	configSet.stepSize = 0.01;
+
+	SIG_EXPECT(recResult, CHECK_AT(1, [](const ExecResult & res) {
+				   CHECK_COMPARE(res.resultKind, ExecResult::ExecResultKind::Ok);
+				   CHECK_COMPARE(res.segments.size(), 1);
+				   CHECK_VERIFY(res.segments.first().isPoint());
+				   CHECK_RETURN
+			   }))
+
+	emit exec(inputData);
+
+	SIG_CHECK
+
+	// * Test: out of core, the segments exceed the stack size and are spilled to a file
+
+	inputData->meta.levelOfDetail = false;
+	inputData->meta.outOfCore = true;
+	configSet.definitions = {Definition('A', "AA")};
+	configSet.startAngle = 0;
+	configSet.numIter = 11;
+
+	SIG_EXPECT(recResult, CHECK_AT(1, [](const ExecResult & res) {
+				   CHECK_COMPARE(res.resultKind, ExecResult::ExecResultKind::Ok);
+				   CHECK_VERIFY(res.segments.isEmpty() && res.spilledSegments);
+				   CHECK_COMPARE(res.spilledSegments->size(), 2048);
+				   LineSeg lastSeg{};
+				   res.spilledSegments->forEachRange(2047, 2048, [&](const LineSeg * segs, qsizetype, qint64) { lastSeg = segs[0]; });
+				   CHECK_COMPARE(print(lastSeg), "L((2047, 0), (2048, 0))");
+				   CHECK_RETURN
+			   }))
+
+	emit exec(inputData);
+
+	SIG_CHECK
+
+	// * Test: out of core, more segments than one chunk, the ranges are passed in pieces of at most one chunk
+
+	configSet.numIter = 17;
+
+	SIG_EXPECT(recResult, CHECK_AT(1, [](const ExecResult & res) {
+				   CHECK_COMPARE(res.resultKind, ExecResult::ExecResultKind::Ok);
+				   CHECK_VERIFY(res.spilledSegments);
+				   CHECK_COMPARE(res.spilledSegments->size(), 2 * SegmentSpill::ChunkSegments);
+				   QList<qint64> firsts;
+				   LineSeg lastSeg{};
+				   const qint64 size = res.spilledSegments->size();
+				   res.spilledSegments->forEachRange(0, size, [&](const LineSeg * segs, qsizetype count, qint64 first) {
+					   firsts << first;
+					   lastSeg = segs[count - 1];
+				   });
+				   CHECK_COMPARE(firsts, QList<qint64>({0, SegmentSpill::ChunkSegments}));
+				   CHECK_COMPARE(print(lastSeg), "L((131071, 0), (131072, 0))");
+				   QList<LineSeg> acrossBorder;
+				   res.spilledSegments->forEachRange(SegmentSpill::ChunkSegments - 1,
+													 SegmentSpill::ChunkSegments + 1,
+													 [&](const LineSeg * segs, qsizetype count, qint64) {
+														 for (qsizetype i = 0; i < count; ++i) acrossBorder << segs[i];
+													 });
+				   CHECK_COMPARE(acrossBorder.size(), 2);
+				   CHECK_COMPARE(print(acrossBorder.last()), "L((65536, 0), (65537, 0))");
+				   CHECK_RETURN
+			   }))
+
+	emit exec(inputData);
+
+	SIG_CHECK
+
+	inputData->meta.outOfCore = false;
+
+	// * Test: expansion cache, the fingerprint ignores the name
+
+	QTemporaryDir cacheDir;
+	ExpansionCache cache(cacheDir.path());
+	const LineSegs segs = {LineSeg{QPointF(0, 0), QPointF(0, -1), 1}, LineSeg{QPointF(0, -1), QPointF(1, -1), 2}};
+	ConfigSet renamedSet = configSet;
+	renamedSet.name = "renamed";
+	QCOMPARE(ExpansionCache::fingerprint(renamedSet), ExpansionCache::fingerprint(configSet));
+	QVERIFY(cache.store(ExpansionCache::fingerprint(configSet), {segs, std::nullopt}));
+	const std::optional<ExpansionCache::Entry> entry = cache.load(ExpansionCache::fingerprint(renamedSet));
+	QVERIFY(entry && !entry->segmentsLastIter);
+	QCOMPARE(print(entry->segments), print(segs));
+	renamedSet.numIter = 3;
+	QVERIFY(!cache.load(ExpansionCache::fingerprint(renamedSet)));
+
+	// * Test: config journal, the torn last line of a crash is skipped and the journal is compacted into the config file
+
+	QTemporaryDir configDir;
+	const QString previousDir = QDir::currentPath();
+	QVERIFY(QDir::setCurrent(configDir.path()));
+	AppSettings journaledSettings;
+	journaledSettings.maxStackSize = 1234;
+	const QJsonObject configJson = configSet.toJson();
+	QByteArray journalLines;
+	for (const QJsonObject & entry : {
+			 QJsonObject{{JsonKeyJournalOp, JsonJournalOpStore}, {JsonKeyJournalName, "kept"}, {JsonKeyJournalConfig, configJson}},
+			 QJsonObject{{JsonKeyJournalOp, JsonJournalOpStore}, {JsonKeyJournalName, "removed"}, {JsonKeyJournalConfig, configJson}},
+			 QJsonObject{{JsonKeyJournalOp, JsonJournalOpRemove}, {JsonKeyJournalName, "removed"}},
+			 QJsonObject{{JsonKeyJournalOp, JsonJournalOpSettings}, {JsonKeySettings, journaledSettings.toJson()}}}) {
+		journalLines += QJsonDocument(entry).toJson(QJsonDocument::Compact) + '\n';
+	}
+	journalLines += "{\"op\":\"store\",\"name\":\"torn\",\"con";
+	{
+		QFile journal("config.journal");
+		QVERIFY(journal.open(QFile::WriteOnly));
+		QCOMPARE(journal.write(journalLines), static_cast<qint64>(journalLines.size()));
+	}
+
+	ConfigMap userConfigs;
+	{
+		ConfigFileStore configFileStore;
+		connect(&configFileStore, &ConfigFileStore::loadedPreAndUserConfigs, [&userConfigs](const ConfigMap &, const ConfigMap & configs) {
+			userConfigs = configs;
+		});
+		configFileStore.loadConfig();
+		QCOMPARE(configFileStore.getSettings().maxStackSize, 1234u);
+	} // waits for the compaction
+	QVERIFY(QDir::setCurrent(previousDir));
+
+	QCOMPARE(userConfigs.keys(), QStringList({"kept"}));
+	QVERIFY(userConfigs["kept"].definitions == configSet.definitions);
+	QCOMPARE(userConfigs["kept"].numIter, configSet.numIter);
+	QVERIFY(QFileInfo(configDir.filePath("config.journal")).size() == 0);
+	QFile configFile(configDir.filePath("config.json"));
+	QVERIFY(configFile.open(QFile::ReadOnly));
+	const AppConfig compacted(QJsonDocument::fromJson(configFile.readAll()).object());
+	QVERIFY(!compacted.isNull);
+	QCOMPARE(compacted.configMap.keys(), QStringList({"kept"}));
+	QCOMPARE(compacted.configMap["kept"].numIter, configSet.numIter);
+	QCOMPARE(compacted.settings.maxStackSize, 1234u);
 }
 
 QTEST_MAIN(SimulatorBaseTest)
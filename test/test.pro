@@ -1,4 +1,4 @@
-QT += core testlib gui
+QT += core testlib gui concurrent
 
 CONFIG += c++17
 
@@ -15,10 +15,14 @@ SOURCES +=  \
 HEADERS += \
 	../lsystemapp/simulator.h \
 	../lsystemapp/common.h \
+	../lsystemapp/configfilestore.h \
+	../lsystemapp/expansioncache.h \
 
 SOURCES +=  \
 	../lsystemapp/simulator.cpp \
 	../lsystemapp/common.cpp \
+	../lsystemapp/configfilestore.cpp \
+	../lsystemapp/expansioncache.cpp \
 
 
 # include lib for utils&tests